@@ -0,0 +1,212 @@
+#include "compute_graph.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+
+namespace vfs {
+
+namespace {
+
+bool AnyOverlap(const std::vector<ComputeGraph::Range>& a,
+                const std::vector<ComputeGraph::Range>& b,
+                bool skip_disjoint = false) {
+    for (const auto& ra : a) {
+        for (const auto& rb : b) {
+            if (skip_disjoint && ra.disjoint && rb.disjoint)
+                continue;
+            if (ra.Overlaps(rb))
+                return true;
+        }
+    }
+    return false;
+}
+
+// Read after write, write after read or write after write
+bool Conflicts(const std::vector<ComputeGraph::Range>& earlier_reads,
+               const std::vector<ComputeGraph::Range>& earlier_writes,
+               const std::vector<ComputeGraph::Range>& reads,
+               const std::vector<ComputeGraph::Range>& writes) {
+    return AnyOverlap(earlier_writes, reads) || AnyOverlap(earlier_writes, writes, true) ||
+           AnyOverlap(earlier_reads, writes);
+}
+
+}  // namespace
+
+ComputeGraph::ComputeGraph(VkCommandBuffer cmd, KernelTimer* timer) : cmd(cmd), timer(timer) {
+    if (timer)
+        timer->Start(cmd);
+}
+
+void ComputeGraph::Dispatch(ComputePipeline& pipeline,
+                            u32 kernel_id,
+                            glm::ivec3 group_count,
+                            const void* push_constants,
+                            std::vector<Range> reads,
+                            std::vector<Range> writes) {
+    Add(
+        {
+            .pipeline = &pipeline,
+            .kernel_id = kernel_id,
+            .group_count = group_count,
+            .indirect_args = nullptr,
+            .reads = std::move(reads),
+            .writes = std::move(writes),
+        },
+        push_constants);
+}
+
+void ComputeGraph::DispatchIndirect(ComputePipeline& pipeline,
+                                    u32 kernel_id,
+                                    const gfx::Buffer& args,
+                                    const void* push_constants,
+                                    std::vector<Range> reads,
+                                    std::vector<Range> writes) {
+    reads.push_back(args);
+
+    Add(
+        {
+            .pipeline = &pipeline,
+            .kernel_id = kernel_id,
+            .group_count = {},
+            .indirect_args = &args,
+            .reads = std::move(reads),
+            .writes = std::move(writes),
+        },
+        push_constants);
+}
+
+void ComputeGraph::Add(Pass&& pass, const void* push_constants) {
+    const auto push_size = pass.pipeline->PushConstSize();
+    assert(push_size <= pass.push_constants.size());
+
+    if (push_constants && push_size > 0)
+        std::memcpy(pass.push_constants.data(), push_constants, push_size);
+
+    pass.reads.insert(pass.reads.end(), shared_reads.begin(), shared_reads.end());
+    pending.push_back(std::move(pass));
+}
+
+void ComputeGraph::Flush() {
+    if (pending.empty())
+        return;
+
+    // Level 0 can run right away, every other level waits for the previous one
+    std::vector<u32> levels(pending.size(), 0);
+    u32 max_level = 0;
+
+    for (u32 i = 0; i < pending.size(); i++) {
+        auto& level = levels[i];
+
+        if (serialize || timer) {
+            level = i + (in_flight_reads.empty() && in_flight_writes.empty() ? 0 : 1);
+        } else {
+            level = DependsOnInFlight(pending[i]) ? 1 : 0;
+            for (u32 j = 0; j < i; j++) {
+                if (levels[j] >= level && Conflicts(pending[j].reads, pending[j].writes,
+                                                    pending[i].reads, pending[i].writes))
+                    level = levels[j] + 1;
+            }
+        }
+
+        max_level = std::max(max_level, level);
+    }
+
+    for (u32 level = 0; level <= max_level; level++) {
+        if (level > 0)
+            EmitBarrier();
+
+        for (u32 i = 0; i < pending.size(); i++) {
+            if (levels[i] == level)
+                Record(pending[i]);
+        }
+    }
+
+    pending.clear();
+}
+
+void ComputeGraph::BeginScope(const std::string& name) {
+    if (!timer)
+        return;
+
+    Flush();
+    timer->BeginScope(cmd, name);
+}
+
+void ComputeGraph::EndScope() {
+    if (!timer)
+        return;
+
+    Flush();
+    timer->EndScope(cmd);
+}
+
+void ComputeGraph::Barrier() {
+    Flush();
+
+    auto mem_barrier = VkMemoryBarrier2{
+        .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER_2,
+        .srcStageMask = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT,
+        .srcAccessMask = VK_ACCESS_2_MEMORY_WRITE_BIT,
+        .dstStageMask = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT,
+        .dstAccessMask = VK_ACCESS_2_MEMORY_READ_BIT | VK_ACCESS_2_MEMORY_WRITE_BIT,
+    };
+
+    auto dep_info = VkDependencyInfo{
+        .sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO,
+        .pMemoryBarriers = &mem_barrier,
+        .memoryBarrierCount = 1,
+    };
+
+    vkCmdPipelineBarrier2(cmd, &dep_info);
+    stats.barriers++;
+
+    in_flight_reads.clear();
+    in_flight_writes.clear();
+}
+
+void ComputeGraph::Record(Pass& pass) {
+    if (pass.indirect_args) {
+        pass.pipeline->ComputeIndirect(cmd, pass.kernel_id, pass.indirect_args->buffer, 0,
+                                       pass.push_constants.data());
+    } else {
+        pass.pipeline->Compute(cmd, pass.kernel_id, pass.group_count, pass.push_constants.data());
+    }
+
+    if (timer)
+        timer->Mark(cmd, pass.pipeline->KernelName(pass.kernel_id));
+
+    in_flight_reads.insert(in_flight_reads.end(), pass.reads.begin(), pass.reads.end());
+    in_flight_writes.insert(in_flight_writes.end(), pass.writes.begin(), pass.writes.end());
+    stats.dispatches++;
+}
+
+void ComputeGraph::EmitBarrier() {
+    auto mem_barrier = VkMemoryBarrier2{
+        .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER_2,
+        .srcStageMask = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT,
+        .srcAccessMask = VK_ACCESS_2_SHADER_WRITE_BIT,
+        .dstStageMask =
+            VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_2_DRAW_INDIRECT_BIT,
+        .dstAccessMask = VK_ACCESS_2_SHADER_READ_BIT | VK_ACCESS_2_SHADER_WRITE_BIT |
+                         VK_ACCESS_2_INDIRECT_COMMAND_READ_BIT,
+    };
+
+    auto dep_info = VkDependencyInfo{
+        .sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO,
+        .pMemoryBarriers = &mem_barrier,
+        .memoryBarrierCount = 1,
+    };
+
+    vkCmdPipelineBarrier2(cmd, &dep_info);
+    stats.barriers++;
+
+    in_flight_reads.clear();
+    in_flight_writes.clear();
+}
+
+bool ComputeGraph::DependsOnInFlight(const Pass& pass) const {
+    return Conflicts(in_flight_reads, in_flight_writes, pass.reads, pass.writes);
+}
+
+}  // namespace vfs
@@ -0,0 +1,119 @@
+#pragma once
+
+#include <array>
+#include <string>
+#include <vector>
+
+#include "compute_pipeline.h"
+#include "gfx/common.h"
+#include "kernel_timer.h"
+
+namespace vfs {
+
+// Records compute dispatches together with the buffer ranges they read and write, and only places a
+// barrier where a dispatch depends on an earlier one. Dispatches added between flushes are grouped
+// by dependency level, so independent ones run back to back with no barrier in between.
+//
+// Every buffer a kernel touches must be declared, including the ones reached through uniform
+// pointers. Commands recorded outside the graph have to be ordered with Flush or Barrier.
+class ComputeGraph {
+public:
+    struct Range {
+        VkDeviceAddress addr{0};
+        VkDeviceSize size{0};
+        // Set on writes to elements that no other disjoint write of the range touches, e.g. two
+        // kernels scattering to different slots. Those are not ordered against each other.
+        bool disjoint{false};
+
+        Range() = default;
+        Range(VkDeviceAddress addr, VkDeviceSize size) : addr(addr), size(size) {}
+        Range(const gfx::Buffer& buffer) : addr(buffer.device_addr), size(buffer.size) {}
+
+        static Range Disjoint(const gfx::Buffer& buffer) {
+            auto range = Range(buffer);
+            range.disjoint = true;
+            return range;
+        }
+
+        bool Overlaps(const Range& other) const {
+            return addr < other.addr + other.size && other.addr < addr + size;
+        }
+    };
+
+    struct Stats {
+        u32 dispatches;
+        u32 barriers;
+    };
+
+    // With a timer every dispatch is timed on its own, so they are serialized
+    explicit ComputeGraph(VkCommandBuffer cmd, KernelTimer* timer = nullptr);
+    ~ComputeGraph() { Flush(); }
+
+    ComputeGraph(const ComputeGraph&) = delete;
+    ComputeGraph& operator=(const ComputeGraph&) = delete;
+
+    // A written range may also be read by the same dispatch
+    void Dispatch(ComputePipeline& pipeline,
+                  u32 kernel_id,
+                  glm::ivec3 group_count,
+                  const void* push_constants,
+                  std::vector<Range> reads,
+                  std::vector<Range> writes);
+    // Group count is read from a VkDispatchIndirectCommand at the start of `args`
+    void DispatchIndirect(ComputePipeline& pipeline,
+                          u32 kernel_id,
+                          const gfx::Buffer& args,
+                          const void* push_constants,
+                          std::vector<Range> reads,
+                          std::vector<Range> writes);
+
+    // Range read by every dispatch added after, for buffers the kernels reach through data the
+    // graph does not see (e.g. the step data)
+    void AddSharedRead(const Range& range) { shared_reads.push_back(range); }
+
+    // Records the pending dispatches. Needed before commands that must stay in recording order,
+    // such as conditional rendering blocks. Later dispatches still wait on these when they depend
+    // on them.
+    void Flush();
+    // Flushes and waits for all previous work, for commands outside the graph that touch the same
+    // buffers (e.g. copies).
+    void Barrier();
+
+    // Named group of dispatches for the timer, ignored without one
+    void BeginScope(const std::string& name);
+    void EndScope();
+
+    VkCommandBuffer Cmd() const { return cmd; }
+    Stats GetStats() const { return stats; }
+
+    // Puts a barrier between every pair of dispatches, for comparison and debugging
+    static inline bool serialize{false};
+
+private:
+    struct Pass {
+        ComputePipeline* pipeline;
+        u32 kernel_id;
+        glm::ivec3 group_count;
+        const gfx::Buffer* indirect_args;
+        std::array<u8, 128> push_constants;
+        std::vector<Range> reads;
+        std::vector<Range> writes;
+    };
+
+    VkCommandBuffer cmd;
+    KernelTimer* timer;
+    Stats stats{};
+
+    std::vector<Pass> pending;
+    std::vector<Range> shared_reads;
+    // Accesses of the dispatches recorded since the last barrier
+    std::vector<Range> in_flight_reads;
+    std::vector<Range> in_flight_writes;
+
+    void Add(Pass&& pass, const void* push_constants);
+    void Record(Pass& pass);
+    void EmitBarrier();
+    bool DependsOnInFlight(const Pass& pass) const;
+};
+
+}  // namespace vfs
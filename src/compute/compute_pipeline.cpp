@@ -1,6 +1,9 @@
 #include "compute_pipeline.h"
 
+#include <algorithm>
 #include <cstddef>
+#include <future>
+#include <thread>
 
 #include "gfx/common.h"
 #include "gfx/vk_util.h"
@@ -11,7 +14,8 @@ namespace vfs {
 void ComputePipeline::Init(const gfx::CoreCtx& ctx, const Config& input_config) {
     config = input_config;
 
-    auto shader = vk::util::LoadShaderModule(
+    // Kept for the variants built with other constants
+    shader = vk::util::LoadShaderModule(
         ctx, Platform::Info::ResourcePath(config.shader_path.c_str()).c_str());
 
     auto push_constant_range = VkPushConstantRange{
@@ -29,11 +33,96 @@ void ComputePipeline::Init(const gfx::CoreCtx& ctx, const Config& input_config)
     i32 id = 0;
     for (const auto& kernel : config.kernels) {
         ids[kernel] = id++;
-        pipelines.push_back(
-            vk::util::BuildComputePipeline(ctx.device, layout, shader, kernel.c_str()));
     }
 
-    vkDestroyShaderModule(ctx.device, shader, nullptr);
+    BuildVariant(ctx, config.constants);
+}
+
+void ComputePipeline::Specialize(const gfx::CoreCtx& ctx,
+                                 const std::vector<SpecializationConstant>& constants) {
+    for (u32 i = 0; i < variants.size(); i++) {
+        if (variants[i].constants == constants) {
+            active = i;
+            variants[i].frames_unused = 0;
+            return;
+        }
+    }
+
+    BuildVariant(ctx, constants);
+}
+
+void ComputePipeline::BeginFrame(const gfx::CoreCtx& ctx) {
+    // Same delay as a retired gfx::CommandCache buffer, which may still hold these kernels
+    for (u32 i = 0; i < variants.size();) {
+        if (i == active || ++variants[i].frames_unused <= gfx::FRAME_COUNT + 1) {
+            i++;
+            continue;
+        }
+
+        DestroyVariant(ctx, variants[i]);
+        variants.erase(variants.begin() + i);
+        if (active > i)
+            active--;
+    }
+}
+
+void ComputePipeline::BuildVariant(const gfx::CoreCtx& ctx,
+                                   const std::vector<SpecializationConstant>& constants) {
+    auto entries = std::vector<VkSpecializationMapEntry>{};
+    auto values = std::vector<u32>{};
+
+    for (const auto& constant : constants) {
+        entries.push_back({
+            .constantID = constant.id,
+            .offset = (u32)(values.size() * sizeof(u32)),
+            .size = sizeof(u32),
+        });
+        values.push_back(constant.value);
+    }
+
+    auto specialization = VkSpecializationInfo{
+        .mapEntryCount = (u32)entries.size(),
+        .pMapEntries = entries.data(),
+        .dataSize = values.size() * sizeof(u32),
+        .pData = values.data(),
+    };
+
+    const auto* specialization_info = constants.empty() ? nullptr : &specialization;
+    const auto n_kernels = (u32)config.kernels.size();
+
+    auto variant = Variant{
+        .constants = constants,
+        .pipelines = std::vector<VkPipeline>(n_kernels, VK_NULL_HANDLE),
+    };
+
+    // Nothing to compile, and the thread count below needs at least one kernel
+    if (n_kernels == 0) {
+        active = (u32)variants.size();
+        variants.push_back(std::move(variant));
+        return;
+    }
+
+    // Drivers compile the kernels of a single call one after the other, so they are spread over
+    // threads. The pipeline cache is internally synchronized.
+    const auto n_threads = std::clamp(std::thread::hardware_concurrency(), 1u, n_kernels);
+    auto tasks = std::vector<std::future<void>>{};
+
+    for (u32 t = 0; t < n_threads; t++) {
+        tasks.push_back(std::async(std::launch::async, [&, t]() {
+            for (u32 i = t; i < n_kernels; i += n_threads) {
+                variant.pipelines[i] = vk::util::BuildComputePipeline(
+                    ctx.device, layout, shader, config.kernels[i].c_str(), specialization_info,
+                    ctx.pipeline_cache);
+            }
+        }));
+    }
+
+    for (auto& task : tasks) {
+        task.get();
+    }
+
+    active = (u32)variants.size();
+    variants.push_back(std::move(variant));
 }
 
 u32 ComputePipeline::FindKernelId(const std::string& entry_point) {
@@ -44,7 +133,8 @@ void ComputePipeline::Compute(VkCommandBuffer cmd,
                               u32 kernel_id,
                               glm::ivec3 group_count,
                               void* push_constants) {
-    vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, pipelines[kernel_id]);
+    vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE,
+                      variants[active].pipelines[kernel_id]);
 
     if (config.set) {
         vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, layout, 0, 1, &config.set, 0,
@@ -58,10 +148,44 @@ void ComputePipeline::Compute(VkCommandBuffer cmd,
     vkCmdDispatch(cmd, group_count.x, group_count.y, group_count.z);
 }
 
+void ComputePipeline::ComputeIndirect(VkCommandBuffer cmd,
+                                      u32 kernel_id,
+                                      VkBuffer args,
+                                      VkDeviceSize offset,
+                                      void* push_constants) {
+    vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE,
+                      variants[active].pipelines[kernel_id]);
+
+    if (config.set) {
+        vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, layout, 0, 1, &config.set, 0,
+                                0);
+    }
+
+    vkCmdPushConstants(cmd, layout, VK_SHADER_STAGE_COMPUTE_BIT, 0, config.push_const_size,
+                       push_constants);
+
+    vkCmdDispatchIndirect(cmd, args, offset);
+}
+
 void ComputePipeline::Clear(const gfx::CoreCtx& ctx) {
-    for (auto& pipeline : pipelines) {
+    for (auto& variant : variants) {
+        DestroyVariant(ctx, variant);
+    }
+
+    variants.clear();
+    active = 0;
+
+    if (shader)
+        vkDestroyShaderModule(ctx.device, shader, nullptr);
+    shader = VK_NULL_HANDLE;
+}
+
+void ComputePipeline::DestroyVariant(const gfx::CoreCtx& ctx, Variant& variant) {
+    for (auto& pipeline : variant.pipelines) {
         vkDestroyPipeline(ctx.device, pipeline, nullptr);
     }
+
+    variant.pipelines.clear();
 }
 
 void ComputeToComputePipelineBarrier(VkCommandBuffer cmd) {
@@ -81,6 +205,25 @@ void ComputeToComputePipelineBarrier(VkCommandBuffer cmd) {
 
     vkCmdPipelineBarrier2(cmd, &dep_info);
 }
+void ComputeToIndirectDispatchBarrier(VkCommandBuffer cmd) {
+    auto mem_barrier = VkMemoryBarrier2{
+        .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER_2,
+        .srcStageMask = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT,
+        .srcAccessMask = VK_ACCESS_2_SHADER_WRITE_BIT,
+        .dstStageMask =
+            VK_PIPELINE_STAGE_2_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT,
+        .dstAccessMask = VK_ACCESS_2_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_2_SHADER_READ_BIT,
+    };
+
+    auto dep_info = VkDependencyInfo{
+        .sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO,
+        .pMemoryBarriers = &mem_barrier,
+        .memoryBarrierCount = 1,
+    };
+
+    vkCmdPipelineBarrier2(cmd, &dep_info);
+}
+
 void ComputeToGraphicsPipelineBarrier(VkCommandBuffer cmd) {
     auto mem_barrier = VkMemoryBarrier2{
         .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER_2,
@@ -10,30 +10,71 @@ namespace vfs {
 
 class ComputePipeline {
 public:
+    // Value of the shader constant declared with [vk::constant_id(id)]. Floats are passed with
+    // std::bit_cast.
+    struct SpecializationConstant {
+        u32 id;
+        u32 value;
+
+        bool operator==(const SpecializationConstant&) const = default;
+    };
+
     struct Config {
         uint32_t push_const_size{0};
         VkDescriptorSet set{nullptr};
         VkDescriptorSetLayout layout{nullptr};
         std::string shader_path{""};
         std::vector<std::string> kernels{{"main"}};
+        std::vector<SpecializationConstant> constants{};
     };
 
     void Init(const gfx::CoreCtx& ctx, const Config& config);
+    // Switches to the kernels built with other constant values, building them the first time.
+    // Commands recorded before keep the previous kernels until BeginFrame retires them.
+    void Specialize(const gfx::CoreCtx& ctx, const std::vector<SpecializationConstant>& constants);
+    // Destroys the variants that have not been active since the frames that may still be
+    // executing them. Must be called once per frame when the pipeline is specialized.
+    void BeginFrame(const gfx::CoreCtx& ctx);
     void Compute(VkCommandBuffer cmd,
                  u32 kernel_id,
                  glm::ivec3 group_count,
                  void* push_constants = nullptr);
+    // Group count is read from a VkDispatchIndirectCommand in `args` at `offset`
+    void ComputeIndirect(VkCommandBuffer cmd,
+                         u32 kernel_id,
+                         VkBuffer args,
+                         VkDeviceSize offset = 0,
+                         void* push_constants = nullptr);
     void Clear(const gfx::CoreCtx& ctx);
     u32 FindKernelId(const std::string& entry_point);
+    u32 PushConstSize() const { return config.push_const_size; }
+    const std::string& KernelName(u32 kernel_id) const { return config.kernels[kernel_id]; }
+    const std::vector<SpecializationConstant>& Constants() const {
+        return variants[active].constants;
+    }
+    u32 VariantCount() const { return (u32)variants.size(); }
 
 private:
+    struct Variant {
+        std::vector<SpecializationConstant> constants;
+        std::vector<VkPipeline> pipelines;
+        u32 frames_unused{0};
+    };
+
     Config config;
     std::unordered_map<std::string, u32> ids;
-    std::vector<VkPipeline> pipelines;
+    std::vector<Variant> variants;
+    u32 active{0};
+    VkShaderModule shader{VK_NULL_HANDLE};
     VkPipelineLayout layout;
+
+    void BuildVariant(const gfx::CoreCtx& ctx,
+                      const std::vector<SpecializationConstant>& constants);
+    void DestroyVariant(const gfx::CoreCtx& ctx, Variant& variant);
 };
 
 void ComputeToComputePipelineBarrier(VkCommandBuffer cmd);
+void ComputeToIndirectDispatchBarrier(VkCommandBuffer cmd);
 void ComputeToGraphicsPipelineBarrier(VkCommandBuffer cmd);
 
 }  // namespace vfs
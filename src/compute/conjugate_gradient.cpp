@@ -0,0 +1,149 @@
+#include "conjugate_gradient.h"
+
+namespace vfs {
+
+namespace {
+// Fixed in the shader, the reductions use a workgroup-sized shared array
+constexpr u32 CG_GROUP_SIZE = 256;
+
+struct CGPushConstants {
+    VkDeviceAddress x;
+    VkDeviceAddress b;
+    VkDeviceAddress r;
+    VkDeviceAddress z;
+    VkDeviceAddress p;
+    VkDeviceAddress ap;
+    VkDeviceAddress inv_diagonal;
+    VkDeviceAddress partials;
+    VkDeviceAddress scalars;
+    VkDeviceAddress state;
+    u32 n;
+    u32 components;
+    u32 n_groups;
+    float rhs_floor;
+};
+
+struct Scalars {
+    float rz;
+    float alpha;
+    float beta;
+};
+
+enum CGKernels : u32 {
+    KernelCopyGuess = 0,
+    KernelResidual,
+    KernelReduceResidual,
+    KernelDirectionDot,
+    KernelReduceAlpha,
+    KernelUpdateSolution,
+    KernelReduceBeta,
+    KernelUpdateDirection,
+};
+}  // namespace
+
+void GPUConjugateGradient::Init(const gfx::CoreCtx& ctx, u32 n, const Layout& layout) {
+    this->n = n;
+    this->layout = layout;
+    n_groups = n / CG_GROUP_SIZE + 1;
+
+    const auto size = n * layout.components;
+    x = gfx::CreateDataBuffer<float>(ctx, size);
+    b = gfx::CreateDataBuffer<float>(ctx, size);
+    r = gfx::CreateDataBuffer<float>(ctx, size);
+    z = gfx::CreateDataBuffer<float>(ctx, size);
+    p = gfx::CreateDataBuffer<float>(ctx, size);
+    ap = gfx::CreateDataBuffer<float>(ctx, size);
+    if (layout.preconditioned)
+        inv_diagonal = gfx::CreateDataBuffer<float>(ctx, size);
+    if (layout.counted)
+        element_count = gfx::CreateDataBuffer<u32>(ctx, 1);
+    partials = gfx::CreateDataBuffer<float>(ctx, n_groups);
+    scalars = gfx::CreateDataBuffer<Scalars>(ctx, 1);
+
+    loop.Init(ctx, n);
+
+    pipeline.Init(ctx, {.shader_path = "shaders/compiled/conjugate_gradient.slang.spv",
+                        .kernels =
+                            {
+                                "CopyGuess",
+                                "Residual",
+                                "ReduceResidual",
+                                "DirectionDot",
+                                "ReduceAlpha",
+                                "UpdateSolution",
+                                "ReduceBeta",
+                                "UpdateDirection",
+                            },
+                        .push_const_size = sizeof(CGPushConstants)});
+}
+
+void GPUConjugateGradient::Clear(const gfx::CoreCtx& ctx) {
+    x.Destroy();
+    b.Destroy();
+    r.Destroy();
+    z.Destroy();
+    p.Destroy();
+    ap.Destroy();
+    inv_diagonal.Destroy();
+    element_count.Destroy();
+    partials.Destroy();
+    scalars.Destroy();
+    loop.Clear(ctx);
+    pipeline.Clear(ctx);
+}
+
+void GPUConjugateGradient::Solve(ComputeGraph& graph,
+                                 const Config& config,
+                                 const std::function<void(ComputeGraph&)>& product) {
+    auto pc = CGPushConstants{
+        .x = x.device_addr,
+        .b = b.device_addr,
+        .r = r.device_addr,
+        .z = z.device_addr,
+        .p = p.device_addr,
+        .ap = ap.device_addr,
+        .inv_diagonal = layout.preconditioned ? inv_diagonal.device_addr : 0,
+        .partials = partials.device_addr,
+        .scalars = scalars.device_addr,
+        .state = loop.StateAddr(0),
+        .n = n,
+        .components = layout.components,
+        .n_groups = n_groups,
+        .rhs_floor = layout.rhs_floor,
+    };
+
+    const auto groups = glm::ivec3(n_groups, 1, 1);
+    const auto single = glm::ivec3(1, 1, 1);
+    const auto state = loop.StateRange(0);
+
+    graph.Dispatch(pipeline, KernelCopyGuess, groups, &pc, {x}, {p});
+    product(graph);
+    graph.Dispatch(pipeline, KernelResidual, groups, &pc, WithPreconditioner({b, ap}),
+                   {r, z, p, partials});
+    graph.Dispatch(pipeline, KernelReduceResidual, single, &pc, {partials}, {scalars});
+
+    const auto* count = layout.counted ? &element_count : nullptr;
+
+    loop.Run(
+        graph, 0, config,
+        [&](ComputeGraph& g) {
+            product(g);
+            g.Dispatch(pipeline, KernelDirectionDot, groups, &pc, {p, ap, state}, {partials});
+            g.Dispatch(pipeline, KernelReduceAlpha, single, &pc, {partials, state}, {scalars});
+            g.Dispatch(pipeline, KernelUpdateSolution, groups, &pc,
+                       WithPreconditioner({b, p, ap, scalars}), {x, r, z, partials, state});
+            g.Dispatch(pipeline, KernelReduceBeta, single, &pc, {partials, state}, {scalars});
+            g.Dispatch(pipeline, KernelUpdateDirection, groups, &pc, {z, scalars, state}, {p});
+        },
+        count);
+}
+
+std::vector<ComputeGraph::Range> GPUConjugateGradient::WithPreconditioner(
+    std::vector<ComputeGraph::Range> reads) const {
+    if (layout.preconditioned)
+        reads.push_back(inv_diagonal);
+
+    return reads;
+}
+
+}  // namespace vfs
@@ -0,0 +1,83 @@
+#pragma once
+
+#include <functional>
+#include <vector>
+
+#include "compute_graph.h"
+#include "compute_pipeline.h"
+#include "gfx/common.h"
+#include "solver_loop.h"
+
+namespace vfs {
+
+// Matrix-free conjugate gradient solve of A x = b, with vectors of n elements (e.g. a vec3 per
+// particle). The caller fills the right-hand side and the initial guess, and records the product
+// A p from the direction buffer into the product buffer. The dot products are reduced on the GPU
+// and the iterations stop there, through a GPUSolverLoop, once the average relative residual of
+// the elements is small enough. With Layout::counted the average only covers the elements the
+// caller counts, so that the unused ones do not dilute it.
+class GPUConjugateGradient {
+public:
+    using Config = GPUSolverLoop::Config;
+
+    struct Layout {
+        // Floats per element
+        u32 components{3};
+        // Smallest right-hand side the residual of an element is measured against
+        float rhs_floor{1e-3f};
+        // Jacobi preconditioning, the caller fills the inverse diagonal
+        bool preconditioned{false};
+        // The caller counts the elements of the system in ElementCount() before the solve
+        bool counted{false};
+    };
+
+    void Init(const gfx::CoreCtx& ctx, u32 n, const Layout& layout);
+    void Clear(const gfx::CoreCtx& ctx);
+
+    // Records the solve, `product` is recorded once for the initial residual and once per
+    // iteration
+    void Solve(ComputeGraph& graph,
+               const Config& config,
+               const std::function<void(ComputeGraph&)>& product);
+
+    // x, initial guess before the solve
+    const gfx::Buffer& Solution() const { return x; }
+    // b
+    const gfx::Buffer& RightHandSide() const { return b; }
+    // p, read by the product
+    const gfx::Buffer& Direction() const { return p; }
+    // A p, written by the product
+    const gfx::Buffer& Product() const { return ap; }
+    // One float per component, only allocated when preconditioned
+    const gfx::Buffer& InverseDiagonal() const { return inv_diagonal; }
+    // One u32, only allocated when counted
+    const gfx::Buffer& ElementCount() const { return element_count; }
+
+    GPUSolverLoop::Stats LastStats() const { return loop.LastStats(0); }
+    bool DrawUI(const char* label, Config& config, float max_tolerance) const {
+        return loop.DrawUI(label, 0, config, max_tolerance);
+    }
+
+private:
+    u32 n{0};
+    u32 n_groups{0};
+    Layout layout;
+    ComputePipeline pipeline;
+    GPUSolverLoop loop;
+
+    gfx::Buffer x;
+    gfx::Buffer b;
+    gfx::Buffer r;
+    gfx::Buffer z;
+    gfx::Buffer p;
+    gfx::Buffer ap;
+    gfx::Buffer inv_diagonal;
+    gfx::Buffer element_count;
+    gfx::Buffer partials;
+    gfx::Buffer scalars;
+
+    std::vector<ComputeGraph::Range> WithPreconditioner(
+        std::vector<ComputeGraph::Range> reads) const;
+};
+
+}  // namespace vfs
@@ -0,0 +1,259 @@
+#include "kernel_timer.h"
+
+#include <algorithm>
+#include <fstream>
+
+namespace vfs {
+
+void KernelTimer::Init(const gfx::CoreCtx& ctx, u32 max_timestamps) {
+    VkPhysicalDeviceProperties props;
+    vkGetPhysicalDeviceProperties(ctx.chosen_gpu, &props);
+
+    if (!props.limits.timestampComputeAndGraphics || props.limits.timestampPeriod <= 0.0f) {
+        fmt::println("Timestamp queries are not supported, kernels will not be timed");
+        return;
+    }
+
+    // Bits past timestampValidBits are undefined
+    u32 queue_family_count = 0;
+    vkGetPhysicalDeviceQueueFamilyProperties(ctx.chosen_gpu, &queue_family_count, nullptr);
+    auto families = std::vector<VkQueueFamilyProperties>(queue_family_count);
+    vkGetPhysicalDeviceQueueFamilyProperties(ctx.chosen_gpu, &queue_family_count,
+                                             families.data());
+
+    const auto valid_bits = families[ctx.compute_queue_family].timestampValidBits;
+    if (valid_bits == 0) {
+        fmt::println("The compute queue has no timestamps, kernels will not be timed");
+        return;
+    }
+    valid_mask = valid_bits >= 64 ? ~0ull : (1ull << valid_bits) - 1;
+
+    this->max_timestamps = max_timestamps;
+    period_ns = props.limits.timestampPeriod;
+
+    auto query_pool_info = VkQueryPoolCreateInfo{
+        .sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO,
+        .queryType = VK_QUERY_TYPE_TIMESTAMP,
+        .queryCount = max_timestamps * gfx::FRAME_COUNT,
+    };
+    VK_CHECK(vkCreateQueryPool(ctx.device, &query_pool_info, nullptr, &pool));
+
+    for (u32 i = 0; i < gfx::FRAME_COUNT; i++) {
+        frames[i].first_query = i * max_timestamps;
+    }
+
+    timestamps.resize(max_timestamps);
+}
+
+void KernelTimer::Clear(const gfx::CoreCtx& ctx) {
+    if (pool)
+        vkDestroyQueryPool(ctx.device, pool, nullptr);
+
+    pool = VK_NULL_HANDLE;
+    results.clear();
+    trace.clear();
+}
+
+void KernelTimer::BeginFrame(const gfx::CoreCtx& ctx, VkCommandBuffer cmd) {
+    if (!Supported())
+        return;
+
+    frame_index = (frame_index + 1) % gfx::FRAME_COUNT;
+    auto& frame = frames[frame_index];
+
+    Resolve(ctx, frame);
+
+    vkCmdResetQueryPool(cmd, pool, frame.first_query, max_timestamps);
+    frame.used_queries = 0;
+    frame.last_query = INVALID_QUERY;
+    frame.scopes.clear();
+    frame.open_scopes.clear();
+}
+
+u32 KernelTimer::Write(VkCommandBuffer cmd) {
+    auto& frame = frames[frame_index];
+    if (!Supported() || frame.used_queries >= max_timestamps)
+        return INVALID_QUERY;
+
+    const auto query = frame.used_queries++;
+    vkCmdWriteTimestamp2(cmd, VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, pool,
+                         frame.first_query + query);
+    return query;
+}
+
+void KernelTimer::Start(VkCommandBuffer cmd) {
+    frames[frame_index].last_query = Write(cmd);
+}
+
+void KernelTimer::Mark(VkCommandBuffer cmd, const std::string& name) {
+    auto& frame = frames[frame_index];
+    const auto query = Write(cmd);
+
+    frame.scopes.push_back({
+        .name = name,
+        .begin = frame.last_query,
+        .end = query,
+        .depth = (u32)frame.open_scopes.size(),
+    });
+    frame.last_query = query;
+}
+
+void KernelTimer::BeginScope(VkCommandBuffer cmd, const std::string& name) {
+    auto& frame = frames[frame_index];
+    const auto query = Write(cmd);
+
+    frame.open_scopes.push_back((u32)frame.scopes.size());
+    frame.scopes.push_back({
+        .name = name,
+        .begin = query,
+        .end = INVALID_QUERY,
+        .depth = (u32)frame.open_scopes.size() - 1,
+    });
+    frame.last_query = query;
+}
+
+void KernelTimer::EndScope(VkCommandBuffer cmd) {
+    auto& frame = frames[frame_index];
+    if (frame.open_scopes.empty())
+        return;
+
+    const auto query = Write(cmd);
+
+    frame.scopes[frame.open_scopes.back()].end = query;
+    frame.open_scopes.pop_back();
+    frame.last_query = query;
+}
+
+void KernelTimer::Resolve(const gfx::CoreCtx& ctx, Frame& frame) {
+    const auto count = frame.used_queries;
+    if (count < 2)
+        return;
+
+    // Not ready only if the frame is still in flight, then it is skipped
+    auto result = vkGetQueryPoolResults(ctx.device, pool, frame.first_query, count,
+                                        count * sizeof(u64), timestamps.data(), sizeof(u64),
+                                        VK_QUERY_RESULT_64_BIT);
+    if (result != VK_SUCCESS)
+        return;
+
+    if (trace_origin == 0)
+        trace_origin = timestamps[0] & valid_mask;
+
+    auto frame_results = std::vector<Timing>{};
+    auto frame_ms = std::vector<float>{};
+    auto events = std::vector<TraceEvent>{};
+
+    for (const auto& scope : frame.scopes) {
+        if (scope.begin == INVALID_QUERY || scope.end == INVALID_QUERY)
+            continue;
+
+        const auto begin = timestamps[scope.begin] & valid_mask;
+        const auto end = timestamps[scope.end] & valid_mask;
+        const auto ms = (float)((end - begin) & valid_mask) * period_ns * 1e-6f;
+
+        events.push_back({
+            .name = scope.name,
+            .start_us = (double)((begin - trace_origin) & valid_mask) * period_ns * 1e-3,
+            .duration_us = (double)ms * 1e3,
+        });
+
+        auto it = std::find_if(frame_results.begin(), frame_results.end(),
+                               [&](const Timing& t) { return t.name == scope.name; });
+        if (it == frame_results.end()) {
+            // Carries the history over from the previous frames
+            auto prev = std::find_if(results.begin(), results.end(),
+                                     [&](const Timing& t) { return t.name == scope.name; });
+            frame_results.push_back(prev != results.end() ? *prev : Timing{.name = scope.name});
+            frame_ms.push_back(0.0f);
+            it = frame_results.end() - 1;
+            it->depth = scope.depth;
+            it->count = 0;
+        }
+
+        frame_ms[it - frame_results.begin()] += ms;
+        it->count++;
+    }
+
+    // Scopes that are no longer recorded, e.g. after switching kernel variants, are dropped
+    for (u32 i = 0; i < frame_results.size(); i++) {
+        UpdateTiming(frame_results[i], frame_ms[i]);
+    }
+    results = std::move(frame_results);
+
+    trace.push_back(std::move(events));
+    if (trace.size() > TRACE_FRAMES)
+        trace.pop_front();
+}
+
+void KernelTimer::UpdateTiming(Timing& timing, float ms) const {
+    timing.last_ms = ms;
+    timing.history[timing.history_next] = ms;
+    timing.history_next = (timing.history_next + 1) % HISTORY_SIZE;
+    timing.history_size = std::min(timing.history_size + 1, HISTORY_SIZE);
+
+    const auto begin = timing.history.begin();
+    const auto end = begin + timing.history_size;
+
+    auto sum = 0.0f;
+    for (auto it = begin; it != end; it++) {
+        sum += *it;
+    }
+
+    timing.mean_ms = sum / (float)timing.history_size;
+    timing.min_ms = *std::min_element(begin, end);
+    timing.max_ms = *std::max_element(begin, end);
+}
+
+float KernelTimer::TotalMs() const {
+    auto total = 0.0f;
+    for (const auto& r : results) {
+        if (r.depth == 0)
+            total += r.mean_ms;
+    }
+    return total;
+}
+
+bool KernelTimer::ExportCSV(const std::string& path) const {
+    auto file = std::ofstream(path);
+    if (!file) {
+        fmt::println("Could not write {}", path);
+        return false;
+    }
+
+    file << "name,depth,count,last_ms,mean_ms,min_ms,max_ms\n";
+    for (const auto& r : results) {
+        file << fmt::format("{},{},{},{:.6f},{:.6f},{:.6f},{:.6f}\n", r.name, r.depth, r.count,
+                            r.last_ms, r.mean_ms, r.min_ms, r.max_ms);
+    }
+
+    fmt::println("Kernel timings written to {}", path);
+    return true;
+}
+
+bool KernelTimer::ExportTrace(const std::string& path) const {
+    auto file = std::ofstream(path);
+    if (!file) {
+        fmt::println("Could not write {}", path);
+        return false;
+    }
+
+    file << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+
+    auto first = true;
+    for (const auto& events : trace) {
+        for (const auto& e : events) {
+            file << fmt::format(
+                "{}\n{{\"name\":\"{}\",\"cat\":\"gpu\",\"ph\":\"X\",\"pid\":0,\"tid\":0,"
+                "\"ts\":{:.3f},\"dur\":{:.3f}}}",
+                first ? "" : ",", e.name, e.start_us, e.duration_us);
+            first = false;
+        }
+    }
+
+    file << "\n]}\n";
+
+    fmt::println("Kernel trace written to {}", path);
+    return true;
+}
+
+}  // namespace vfs
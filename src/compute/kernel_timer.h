@@ -0,0 +1,104 @@
+#pragma once
+
+#include <array>
+#include <deque>
+#include <string>
+#include <vector>
+
+#include "gfx/common.h"
+
+namespace vfs {
+
+// Measures the GPU time of named scopes with timestamp queries. Each frame uses its own range of
+// queries, which is read back when the frame FRAME_COUNT frames later reuses it, so the CPU never
+// waits for the results.
+class KernelTimer {
+public:
+    // Number of frames the rolling statistics are computed over
+    static constexpr u32 HISTORY_SIZE = 120;
+
+    struct Timing {
+        std::string name;
+        // Number of enclosing scopes
+        u32 depth;
+        // Times are the sum over the scopes with this name in a frame
+        float last_ms;
+        float mean_ms;
+        float min_ms;
+        float max_ms;
+        // Scopes with this name in the last frame
+        u32 count;
+
+        std::array<float, HISTORY_SIZE> history;
+        u32 history_size;
+        u32 history_next;
+    };
+
+    void Init(const gfx::CoreCtx& ctx, u32 max_timestamps = 256);
+    void Clear(const gfx::CoreCtx& ctx);
+
+    // Must be recorded before any timestamp of the frame
+    void BeginFrame(const gfx::CoreCtx& ctx, VkCommandBuffer cmd);
+    // Timestamp from which the next scope is measured
+    void Start(VkCommandBuffer cmd);
+    // Closes a scope that began at the previous timestamp, once the work recorded before it is done
+    void Mark(VkCommandBuffer cmd, const std::string& name);
+    // Scope around several marks, which are shown nested in it
+    void BeginScope(VkCommandBuffer cmd, const std::string& name);
+    void EndScope(VkCommandBuffer cmd);
+
+    bool Supported() const { return pool != VK_NULL_HANDLE; }
+    // In the order they were recorded in the last resolved frame
+    const std::vector<Timing>& Results() const { return results; }
+    // Sum of the mean times of the outermost scopes
+    float TotalMs() const;
+
+    // Rolling statistics of every scope
+    bool ExportCSV(const std::string& path) const;
+    // Scopes of the last resolved frames in the Chrome trace event format (chrome://tracing)
+    bool ExportTrace(const std::string& path) const;
+
+private:
+    static constexpr u32 INVALID_QUERY = ~0u;
+    static constexpr u32 TRACE_FRAMES = 60;
+
+    struct Scope {
+        std::string name;
+        u32 begin;
+        u32 end;
+        u32 depth;
+    };
+
+    struct Frame {
+        u32 first_query{0};
+        u32 used_queries{0};
+        u32 last_query{INVALID_QUERY};
+        std::vector<Scope> scopes;
+        // Scopes begun and not ended yet
+        std::vector<u32> open_scopes;
+    };
+
+    struct TraceEvent {
+        std::string name;
+        double start_us;
+        double duration_us;
+    };
+
+    VkQueryPool pool{VK_NULL_HANDLE};
+    float period_ns{1.0f};
+    u64 valid_mask{~0ull};
+    u32 max_timestamps{0};
+    u32 frame_index{0};
+    std::array<Frame, gfx::FRAME_COUNT> frames;
+    std::vector<u64> timestamps;
+    std::vector<Timing> results;
+
+    std::deque<std::vector<TraceEvent>> trace;
+    u64 trace_origin{0};
+
+    u32 Write(VkCommandBuffer cmd);
+    void Resolve(const gfx::CoreCtx& ctx, Frame& frame);
+    void UpdateTiming(Timing& timing, float ms) const;
+};
+
+}  // namespace vfs
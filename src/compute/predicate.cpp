@@ -0,0 +1,67 @@
+#include "predicate.h"
+
+#include "gfx/common.h"
+
+namespace vfs {
+
+void GPUPredicate::Init(const gfx::CoreCtx& ctx, u32 count) {
+    buffer = gfx::Buffer::Create(
+        ctx, count * sizeof(u32),
+        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT |
+            VK_BUFFER_USAGE_CONDITIONAL_RENDERING_BIT_EXT |
+            VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT,
+        VMA_MEMORY_USAGE_AUTO_PREFER_DEVICE);
+
+    supported = ctx.conditional_rendering;
+
+    if (supported) {
+        begin_conditional_rendering = (PFN_vkCmdBeginConditionalRenderingEXT)vkGetDeviceProcAddr(
+            ctx.device, "vkCmdBeginConditionalRenderingEXT");
+        end_conditional_rendering = (PFN_vkCmdEndConditionalRenderingEXT)vkGetDeviceProcAddr(
+            ctx.device, "vkCmdEndConditionalRenderingEXT");
+        supported = begin_conditional_rendering && end_conditional_rendering;
+    }
+}
+
+void GPUPredicate::Clear(const gfx::CoreCtx& ctx) {
+    buffer.Destroy();
+}
+
+void GPUPredicate::Begin(VkCommandBuffer cmd, u32 slot, bool inverted) const {
+    if (!supported)
+        return;
+
+    auto mem_barrier = VkMemoryBarrier2{
+        .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER_2,
+        .srcStageMask = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT,
+        .srcAccessMask = VK_ACCESS_2_SHADER_WRITE_BIT,
+        .dstStageMask = VK_PIPELINE_STAGE_2_CONDITIONAL_RENDERING_BIT_EXT,
+        .dstAccessMask = VK_ACCESS_2_CONDITIONAL_RENDERING_READ_BIT_EXT,
+    };
+
+    auto dep_info = VkDependencyInfo{
+        .sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO,
+        .pMemoryBarriers = &mem_barrier,
+        .memoryBarrierCount = 1,
+    };
+
+    vkCmdPipelineBarrier2(cmd, &dep_info);
+
+    auto begin_info = VkConditionalRenderingBeginInfoEXT{
+        .sType = VK_STRUCTURE_TYPE_CONDITIONAL_RENDERING_BEGIN_INFO_EXT,
+        .buffer = buffer.buffer,
+        .offset = slot * sizeof(u32),
+        .flags = inverted ? VK_CONDITIONAL_RENDERING_INVERTED_BIT_EXT : 0u,
+    };
+
+    begin_conditional_rendering(cmd, &begin_info);
+}
+
+void GPUPredicate::End(VkCommandBuffer cmd) const {
+    if (!supported)
+        return;
+
+    end_conditional_rendering(cmd);
+}
+
+}  // namespace vfs
@@ -0,0 +1,29 @@
+#pragma once
+
+#include "gfx/common.h"
+
+namespace vfs {
+
+// Buffer of 32-bit predicates written by compute shaders. Dispatches recorded between Begin and End
+// are skipped by the GPU when the predicate is zero (or non-zero, if inverted), so the decision
+// never needs a CPU readback. Devices without VK_EXT_conditional_rendering execute every block.
+class GPUPredicate {
+public:
+    void Init(const gfx::CoreCtx& ctx, u32 count = 1);
+    void Clear(const gfx::CoreCtx& ctx);
+
+    void Begin(VkCommandBuffer cmd, u32 slot = 0, bool inverted = false) const;
+    void End(VkCommandBuffer cmd) const;
+
+    bool Supported() const { return supported; }
+    VkDeviceAddress Addr(u32 slot = 0) const { return buffer.device_addr + slot * sizeof(u32); }
+
+private:
+    bool supported{false};
+    gfx::Buffer buffer;
+
+    PFN_vkCmdBeginConditionalRenderingEXT begin_conditional_rendering{nullptr};
+    PFN_vkCmdEndConditionalRenderingEXT end_conditional_rendering{nullptr};
+};
+
+}  // namespace vfs
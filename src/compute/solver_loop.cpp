@@ -0,0 +1,132 @@
+#include "solver_loop.h"
+
+#include <algorithm>
+
+#include "gfx/common.h"
+#include "imgui.h"
+
+namespace vfs {
+
+namespace {
+struct SolverPushConstants {
+    VkDeviceAddress state;
+    VkDeviceAddress predicate;
+    VkDeviceAddress stats;
+    VkDeviceAddress element_count;
+    float tolerance;
+    u32 min_iterations;
+    u32 max_iterations;
+    float error_scale;
+    u32 n;
+};
+
+enum SolverKernels : u32 {
+    KernelResetSolver = 0,
+    KernelCheckConvergence,
+};
+}  // namespace
+
+void GPUSolverLoop::Init(const gfx::CoreCtx& ctx, u32 n, u32 slots) {
+    this->n = n;
+    this->slots = slots;
+
+    states = gfx::CreateDataBuffer<State>(ctx, slots);
+    stats = gfx::CreateReadbackBuffer<Stats>(ctx, slots);
+    std::fill_n((Stats*)stats.Map(), slots, Stats{});
+
+    predicate.Init(ctx, slots);
+
+    pipeline.Init(ctx, {.shader_path = "shaders/compiled/solver_loop.slang.spv",
+                        .kernels = {"ResetSolver", "CheckConvergence"},
+                        .push_const_size = sizeof(SolverPushConstants)});
+}
+
+void GPUSolverLoop::Clear(const gfx::CoreCtx& ctx) {
+    states.Destroy();
+    stats.Destroy();
+    predicate.Clear(ctx);
+    pipeline.Clear(ctx);
+}
+
+void GPUSolverLoop::Run(ComputeGraph& graph,
+                        u32 slot,
+                        const Config& config,
+                        const std::function<void(ComputeGraph&)>& iteration,
+                        const gfx::Buffer* element_count) {
+    auto pc = SolverPushConstants{
+        .state = StateAddr(slot),
+        .predicate = predicate.Addr(slot),
+        .stats = stats.device_addr + slot * sizeof(Stats),
+        .element_count = element_count ? element_count->device_addr : 0,
+        .tolerance = config.tolerance,
+        .min_iterations = config.min_iterations,
+        .max_iterations = std::max(config.max_iterations, 1u),
+        // The errors are clamped to one, so the sum over all particles stays below 2^31
+        .error_scale = 2147483648.0f / (float)std::max(n, 1u),
+        .n = n,
+    };
+
+    const auto predicate_range = ComputeGraph::Range{predicate.Addr(slot), sizeof(u32)};
+    const auto stats_range = ComputeGraph::Range{pc.stats, sizeof(Stats)};
+    auto check_reads = std::vector<ComputeGraph::Range>{};
+    if (element_count)
+        check_reads.push_back(*element_count);
+
+    graph.Dispatch(pipeline, KernelResetSolver, {1, 1, 1}, &pc, {},
+                   {StateRange(slot), predicate_range});
+
+    for (u32 i = 0; i < pc.max_iterations; i++) {
+        graph.Flush();
+        predicate.Begin(graph.Cmd(), slot);
+
+        iteration(graph);
+
+        graph.Flush();
+        predicate.End(graph.Cmd());
+
+        graph.Dispatch(pipeline, KernelCheckConvergence, {1, 1, 1}, &pc, check_reads,
+                       {StateRange(slot), predicate_range, stats_range});
+    }
+}
+
+VkDeviceAddress GPUSolverLoop::StateAddr(u32 slot) const {
+    return states.device_addr + slot * sizeof(State);
+}
+
+ComputeGraph::Range GPUSolverLoop::StateRange(u32 slot) const {
+    return {StateAddr(slot), sizeof(State)};
+}
+
+GPUSolverLoop::Stats GPUSolverLoop::LastStats(u32 slot) const {
+    if (!stats.buffer || slot >= slots)
+        return {};
+
+    stats.Invalidate();
+    return ((const Stats*)stats.Map())[slot];
+}
+
+bool GPUSolverLoop::DrawUI(const char* label, u32 slot, Config& config, float max_tolerance) const {
+    ImGui::PushID(label);
+
+    auto tolerance = config.tolerance * 100.0f;
+    auto changed = false;
+    if (ImGui::DragFloat("Tolerance", &tolerance, 0.01f, 0.01f, max_tolerance, "%.2f%%")) {
+        config.tolerance = tolerance * 0.01f;
+        changed = true;
+    }
+
+    const u32 min_iterations = 1;
+    const u32 max_iterations = 200;
+    changed |= ImGui::DragScalar("Min iterations", ImGuiDataType_U32, &config.min_iterations, 0.1f,
+                                 &min_iterations, &max_iterations);
+    changed |= ImGui::DragScalar("Max iterations", ImGuiDataType_U32, &config.max_iterations, 0.1f,
+                                 &min_iterations, &max_iterations);
+
+    const auto last = LastStats(slot);
+    ImGui::Text("Last solve: %u iterations, %.3f%% error", last.iterations, last.error * 100.0f);
+
+    ImGui::PopID();
+    return changed;
+}
+
+}  // namespace vfs
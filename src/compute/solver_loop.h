@@ -0,0 +1,67 @@
+#pragma once
+
+#include <functional>
+
+#include "compute_graph.h"
+#include "compute_pipeline.h"
+#include "gfx/common.h"
+#include "predicate.h"
+
+namespace vfs {
+
+// Records the iterations of an iterative particle solver, which stops on the GPU once the average
+// error of the particles drops below a tolerance. The kernels of an iteration report their error
+// to the solver state and return early once it is inactive. With conditional rendering the
+// remaining iterations are not dispatched at all. Every solver of a model has its own slot.
+class GPUSolverLoop {
+public:
+    struct Config {
+        // Average error per particle, errors are clamped to one
+        float tolerance{1e-3f};
+        u32 min_iterations{2};
+        u32 max_iterations{20};
+    };
+
+    struct Stats {
+        u32 iterations;
+        float error;
+    };
+
+    void Init(const gfx::CoreCtx& ctx, u32 n, u32 slots = 1);
+    void Clear(const gfx::CoreCtx& ctx);
+
+    // Records up to max_iterations calls of `iteration`, each followed by the convergence check.
+    // The errors are averaged over the u32 in `element_count` when given, e.g. the elements of a
+    // system that only covers part of n, instead of over n.
+    void Run(ComputeGraph& graph,
+             u32 slot,
+             const Config& config,
+             const std::function<void(ComputeGraph&)>& iteration,
+             const gfx::Buffer* element_count = nullptr);
+
+    // SolverState read and written by the kernels of the solver in `slot`
+    VkDeviceAddress StateAddr(u32 slot) const;
+    ComputeGraph::Range StateRange(u32 slot) const;
+    // Last iteration of the last solve recorded in `slot`, read back without waiting
+    Stats LastStats(u32 slot) const;
+    // Settings of a solver and its last stats. Returns true when the settings, which are baked into
+    // the recorded commands, change.
+    bool DrawUI(const char* label, u32 slot, Config& config, float max_tolerance) const;
+
+private:
+    struct State {
+        u32 error_sum;
+        u32 active;
+        u32 iterations;
+        float error_scale;
+    };
+
+    u32 n{0};
+    u32 slots{0};
+    ComputePipeline pipeline;
+    GPUPredicate predicate;
+    gfx::Buffer states;
+    gfx::Buffer stats;
+};
+
+}  // namespace vfs
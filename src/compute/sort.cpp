@@ -1,5 +1,6 @@
 #include "sort.h"
 
+#include <algorithm>
 #include <glm/fwd.hpp>
 
 #include "compute_pipeline.h"
@@ -19,6 +20,11 @@ enum ScanKernels : u32 {
     KernelScanCombine,
 };
 
+enum ReorderKernels : u32 {
+    KernelReorder = 0,
+    KernelReorderCopyBack,
+};
+
 enum SortKernels : u32 {
     KernelClearCounts = 0,
     KernelCalcCounts,
@@ -26,6 +32,22 @@ enum SortKernels : u32 {
     KernelCopyBack,
 };
 
+enum IncrementalSortKernels : u32 {
+    KernelMarkMovers = 0,
+    KernelSelectSortPath,
+    KernelClearMovers,
+    KernelCompactMovers,
+    KernelMergeStayers,
+    KernelMergeMovers,
+    KernelCopyMerged,
+    KernelStorePreviousKeys,
+};
+
+enum IncrementalSortPaths : u32 {
+    PathIncremental = 0,
+    PathFull,
+};
+
 bool CreateBufferIfNeeded(const gfx::CoreCtx& ctx, gfx::Buffer& buf, u32 size) {
     bool create_buf = buf.buffer == nullptr || buf.size < size;
     if (create_buf) {
@@ -54,7 +76,7 @@ void GPUScan::Clear(const gfx::CoreCtx& ctx) {
     }
 }
 
-void GPUScan::Run(VkCommandBuffer cmd, const gfx::CoreCtx& ctx, const gfx::Buffer& elements) {
+void GPUScan::Run(ComputeGraph& graph, const gfx::CoreCtx& ctx, const gfx::Buffer& elements) {
     const u32 threads_per_group = 256;
     const u32 count = elements.size / sizeof(u32);
     int num_groups = (int)std::ceil((float)count / 2.0f / (float)threads_per_group);
@@ -75,13 +97,14 @@ void GPUScan::Run(VkCommandBuffer cmd, const gfx::CoreCtx& ctx, const gfx::Buffe
         .item_count = count,
     };
 
-    scan_pipeline.Compute(cmd, KernelScanBlock, {num_groups, 1, 1}, &push_constants);
-    ComputeToComputePipelineBarrier(cmd);
+    graph.Dispatch(scan_pipeline, KernelScanBlock, {num_groups, 1, 1}, &push_constants, {},
+                   {elements, group_sum_buffer});
 
     if (num_groups > 1) {
         // Recursively scan group_sums
-        Run(cmd, ctx, group_sum_buffer);
-        scan_pipeline.Compute(cmd, KernelScanCombine, {num_groups, 1, 1}, &push_constants);
+        Run(graph, ctx, group_sum_buffer);
+        graph.Dispatch(scan_pipeline, KernelScanCombine, {num_groups, 1, 1}, &push_constants,
+                       {group_sum_buffer}, {elements});
     }
 }
 
@@ -104,7 +127,7 @@ void GPUCountSort::Clear(const gfx::CoreCtx& ctx) {
     counts_buffer.Destroy();
 }
 
-void GPUCountSort::Run(VkCommandBuffer cmd,
+void GPUCountSort::Run(ComputeGraph& graph,
                        const gfx::CoreCtx& ctx,
                        const gfx::Buffer& items,
                        const gfx::Buffer& keys,
@@ -122,24 +145,170 @@ void GPUCountSort::Run(VkCommandBuffer cmd,
         .sorted_keys = sorted_values_buffer.device_addr,
         .counts = counts_buffer.device_addr,
         .item_count = item_count,
+        .count_size = max_value + 1,
     };
 
     u32 n_groups = item_count / 256 + 1;
+    u32 n_clear_groups = std::max(item_count, max_value + 1) / 256 + 1;
 
-    sort_pipeline.Compute(cmd, KernelClearCounts, {n_groups, 1, 1}, &push_consts);
-    ComputeToComputePipelineBarrier(cmd);
+    graph.Dispatch(sort_pipeline, KernelClearCounts, {n_clear_groups, 1, 1}, &push_consts, {},
+                   {counts_buffer, items});
 
-    sort_pipeline.Compute(cmd, KernelCalcCounts, {n_groups, 1, 1}, &push_consts);
-    ComputeToComputePipelineBarrier(cmd);
+    graph.Dispatch(sort_pipeline, KernelCalcCounts, {n_groups, 1, 1}, &push_consts, {keys},
+                   {counts_buffer});
 
-    gpu_scan.Run(cmd, ctx, counts_buffer);
-    ComputeToComputePipelineBarrier(cmd);
+    gpu_scan.Run(graph, ctx, counts_buffer);
 
-    sort_pipeline.Compute(cmd, KernelScatter, {n_groups, 1, 1}, &push_consts);
-    ComputeToComputePipelineBarrier(cmd);
+    graph.Dispatch(sort_pipeline, KernelScatter, {n_groups, 1, 1}, &push_consts, {keys, items},
+                   {counts_buffer, sorted_items_buffer, sorted_values_buffer});
 
-    sort_pipeline.Compute(cmd, KernelCopyBack, {n_groups, 1, 1}, &push_consts);
-    ComputeToComputePipelineBarrier(cmd);
+    graph.Dispatch(sort_pipeline, KernelCopyBack, {n_groups, 1, 1}, &push_consts,
+                   {sorted_items_buffer, sorted_values_buffer}, {items, keys});
+}
+
+void GPUCountSort::Reserve(const gfx::CoreCtx& ctx, u32 item_count, u32 max_value) {
+    CreateBufferIfNeeded(ctx, sorted_items_buffer, item_count * sizeof(u32));
+    CreateBufferIfNeeded(ctx, sorted_values_buffer, item_count * sizeof(u32));
+    CreateBufferIfNeeded(ctx, counts_buffer, (max_value + 1) * sizeof(u32));
+}
+
+void GPUIncrementalSort::Init(const gfx::CoreCtx& ctx,
+                              u32 n,
+                              u32 table_size,
+                              float max_mover_fraction) {
+    this->n = n;
+    this->table_size = table_size;
+    capacity = std::clamp((u32)std::ceil(max_mover_fraction * (float)n), 1u, n);
+
+    incremental_pipeline.Init(
+        ctx, {.shader_path = "shaders/compiled/incremental_sort.slang.spv",
+              .push_const_size = sizeof(PushConstants),
+              .kernels = {"MarkMovers", "SelectSortPath", "ClearMovers", "CompactMovers",
+                          "MergeStayers", "MergeMovers", "CopyMerged", "StorePreviousKeys"}});
+
+    predicate.Init(ctx, 2);
+    sort.Init(ctx);
+    sort.Reserve(ctx, n, table_size);
+    gpu_scan.Init(ctx);
+
+    previous_keys = gfx::CreateDataBuffer<u32>(ctx, n);
+    mover_prefix = gfx::CreateDataBuffer<u32>(ctx, n + 1);
+    mover_keys = gfx::CreateDataBuffer<u32>(ctx, capacity);
+    mover_particles = gfx::CreateDataBuffer<u32>(ctx, capacity);
+    mover_order = gfx::CreateDataBuffer<u32>(ctx, capacity);
+    merged_keys = gfx::CreateDataBuffer<u32>(ctx, n);
+    merged_items = gfx::CreateDataBuffer<u32>(ctx, n);
+    stats = gfx::CreateReadbackBuffer<Stats>(ctx, 1);
+    *(Stats*)stats.Map() = {};
+
+    force_full = true;
+}
+
+void GPUIncrementalSort::Clear(const gfx::CoreCtx& ctx) {
+    incremental_pipeline.Clear(ctx);
+    predicate.Clear(ctx);
+    sort.Clear(ctx);
+    gpu_scan.Clear(ctx);
+
+    previous_keys.Destroy();
+    mover_prefix.Destroy();
+    mover_keys.Destroy();
+    mover_particles.Destroy();
+    mover_order.Destroy();
+    merged_keys.Destroy();
+    merged_items.Destroy();
+    stats.Destroy();
+}
+
+void GPUIncrementalSort::Run(ComputeGraph& graph,
+                             const gfx::CoreCtx& ctx,
+                             const gfx::Buffer& items,
+                             const gfx::Buffer& keys,
+                             const GPUPredicate* gate) {
+    auto push_consts = PushConstants{
+        .keys = keys.device_addr,
+        .items = items.device_addr,
+        .previous_keys = previous_keys.device_addr,
+        .mover_prefix = mover_prefix.device_addr,
+        .mover_keys = mover_keys.device_addr,
+        .mover_particles = mover_particles.device_addr,
+        .mover_order = mover_order.device_addr,
+        .merged_keys = merged_keys.device_addr,
+        .merged_items = merged_items.device_addr,
+        .predicates = predicate.Addr(),
+        .rebuild = gate ? gate->Addr() : 0,
+        .stats = stats.device_addr,
+        .use_rebuild_flag = gate ? 1u : 0u,
+        .force_full = force_full,
+        .capacity = capacity,
+        .table_size = table_size,
+        .n = n,
+    };
+
+    force_full = false;
+
+    u32 n_groups = n / 256 + 1;
+    u32 n_mover_groups = capacity / 256 + 1;
+
+    const auto predicates = ComputeGraph::Range{predicate.Addr(), 2 * sizeof(u32)};
+    const auto rebuild = ComputeGraph::Range{push_consts.rebuild, gate ? sizeof(u32) : 0};
+    auto cmd = graph.Cmd();
+
+    graph.Dispatch(incremental_pipeline, KernelMarkMovers, {(n + 1) / 256 + 1, 1, 1}, &push_consts,
+                   {keys, previous_keys}, {mover_prefix});
+    gpu_scan.Run(graph, ctx, mover_prefix);
+
+    // Conditional blocks cannot be nested, so the gate is closed while a path is chosen
+    graph.Flush();
+    if (gate)
+        gate->End(cmd);
+
+    graph.Dispatch(incremental_pipeline, KernelSelectSortPath, {1, 1, 1}, &push_consts,
+                   {mover_prefix, rebuild}, {predicates, stats});
+    graph.Flush();
+
+    predicate.Begin(cmd, PathIncremental);
+    {
+        graph.Dispatch(incremental_pipeline, KernelClearMovers, {n_mover_groups, 1, 1},
+                       &push_consts, {}, {mover_keys});
+        graph.Dispatch(incremental_pipeline, KernelCompactMovers, {n_groups, 1, 1}, &push_consts,
+                       {keys, previous_keys, mover_prefix}, {mover_keys, mover_particles});
+
+        // Sentinel keys equal to the table size sort after every valid key
+        sort.Run(graph, ctx, mover_order, mover_keys, table_size);
+
+        // Stayers and movers land in different slots of the merged buffers
+        graph.Dispatch(incremental_pipeline, KernelMergeStayers, {n_groups, 1, 1}, &push_consts,
+                       {keys, previous_keys, mover_prefix, mover_keys},
+                       {ComputeGraph::Range::Disjoint(merged_keys),
+                        ComputeGraph::Range::Disjoint(merged_items)});
+        graph.Dispatch(incremental_pipeline, KernelMergeMovers, {n_mover_groups, 1, 1},
+                       &push_consts,
+                       {previous_keys, mover_prefix, mover_keys, mover_particles, mover_order},
+                       {ComputeGraph::Range::Disjoint(merged_keys),
+                        ComputeGraph::Range::Disjoint(merged_items)});
+        graph.Dispatch(incremental_pipeline, KernelCopyMerged, {n_groups, 1, 1}, &push_consts,
+                       {merged_keys, merged_items}, {keys, items, previous_keys});
+        graph.Flush();
+    }
+    predicate.End(cmd);
+
+    predicate.Begin(cmd, PathFull);
+    {
+        sort.Run(graph, ctx, items, keys, table_size - 1);
+        graph.Dispatch(incremental_pipeline, KernelStorePreviousKeys, {n_groups, 1, 1},
+                       &push_consts, {keys}, {previous_keys});
+        graph.Flush();
+    }
+    predicate.End(cmd);
+
+    if (gate)
+        gate->Begin(cmd);
+}
+
+GPUIncrementalSort::Stats GPUIncrementalSort::LastStats() const {
+    stats.Invalidate();
+    return *(Stats*)stats.Map();
 }
 
 void SpatialOffset::Init(const gfx::CoreCtx& ctx) {
@@ -152,27 +321,30 @@ void SpatialOffset::Clear(const gfx::CoreCtx& ctx) {
     offset_pipeline.Clear(ctx);
 }
 
-void SpatialOffset::Run(VkCommandBuffer cmd,
+void SpatialOffset::Run(ComputeGraph& graph,
                         const gfx::CoreCtx& ctx,
                         bool init,
                         const gfx::Buffer& sorted_keys,
                         const gfx::Buffer& offsets) {
     u32 num_inputs = sorted_keys.size / (u32)sizeof(u32);
+    u32 table_size = offsets.size / (u32)sizeof(u32);
 
     auto push_consts = PushConstants{
         .sorted_keys = sorted_keys.device_addr,
         .offsets = offsets.device_addr,
         .num_inputs = num_inputs,
+        .table_size = table_size,
     };
 
     u32 n_groups = num_inputs / 256 + 1;
 
     if (init) {
-        offset_pipeline.Compute(cmd, KernelInitOffsets, {n_groups, 1, 1}, &push_consts);
-        ComputeToComputePipelineBarrier(cmd);
+        graph.Dispatch(offset_pipeline, KernelInitOffsets, {table_size / 256 + 1, 1, 1},
+                       &push_consts, {}, {offsets});
     }
 
-    offset_pipeline.Compute(cmd, KernelCalculateOffsets, {n_groups, 1, 1}, &push_consts);
+    graph.Dispatch(offset_pipeline, KernelCalculateOffsets, {n_groups, 1, 1}, &push_consts,
+                   {sorted_keys}, {offsets});
 }
 
 struct ReorderPushConstants {
@@ -191,7 +363,7 @@ void BufferReorder::Init(const gfx::CoreCtx& ctx, Config&& cfg) {
 
     reorder_pipeline.Init(ctx, {
                                    .shader_path = "shaders/compiled/reorder.slang.spv",
-                                   .kernels = {"Reorder"},
+                                   .kernels = {"Reorder", "CopyBack"},
                                    .push_const_size = sizeof(ReorderPushConstants),
                                });
 }
@@ -203,18 +375,21 @@ void BufferReorder::Clear(const gfx::CoreCtx& ctx) {
 
     reorder_pipeline.Clear(ctx);
 }
-void BufferReorder::Reorder(VkCommandBuffer cmd, const gfx::CoreCtx& ctx) {
+void BufferReorder::Reorder(ComputeGraph& graph, const gfx::CoreCtx& ctx) {
     auto reorder_push_constants = ReorderPushConstants{
         .sorted_indices = config.sort_indices,
         .n = config.n,
     };
 
     glm::vec3 ngroups{config.n / 256 + 1, 1, 1};
+    const auto sort_indices = ComputeGraph::Range{config.sort_indices, config.n * sizeof(u32)};
 
     for (u32 i = 0; i < config.buffers.size(); i++) {
-        reorder_push_constants.buffer = config.buffers[i].addr;
+        const auto& buffer = config.buffers[i];
+        reorder_push_constants.buffer = buffer.addr;
         reorder_push_constants.sort_target = sort_targets[i].device_addr;
-        reorder_pipeline.Compute(cmd, 0, ngroups, &reorder_push_constants);
+        graph.Dispatch(reorder_pipeline, KernelReorder, ngroups, &reorder_push_constants,
+                       {sort_indices, {buffer.addr, buffer.size}}, {sort_targets[i]});
     }
 }
 
@@ -226,4 +401,21 @@ void BufferReorder::Copyback(VkCommandBuffer cmd) {
     }
 }
 
+void BufferReorder::CopybackDispatch(ComputeGraph& graph) {
+    auto reorder_push_constants = ReorderPushConstants{
+        .sorted_indices = config.sort_indices,
+        .n = config.n,
+    };
+
+    glm::ivec3 ngroups{config.n / 256 + 1, 1, 1};
+
+    for (u32 i = 0; i < config.buffers.size(); i++) {
+        const auto& buffer = config.buffers[i];
+        reorder_push_constants.buffer = buffer.addr;
+        reorder_push_constants.sort_target = sort_targets[i].device_addr;
+        graph.Dispatch(reorder_pipeline, KernelReorderCopyBack, ngroups, &reorder_push_constants,
+                       {sort_targets[i]}, {{buffer.addr, buffer.size}});
+    }
+}
+
 }  // namespace vfs
@@ -3,8 +3,10 @@
 #include <unordered_map>
 #include <vector>
 
+#include "compute_graph.h"
 #include "compute_pipeline.h"
 #include "gfx/common.h"
+#include "predicate.h"
 
 namespace vfs {
 
@@ -16,7 +18,7 @@ public:
     void Init(const gfx::CoreCtx& ctx);
     void Clear(const gfx::CoreCtx& ctx);
 
-    void Run(VkCommandBuffer cmd, const gfx::CoreCtx& ctx, const gfx::Buffer& elements);
+    void Run(ComputeGraph& graph, const gfx::CoreCtx& ctx, const gfx::Buffer& elements);
 
 private:
     struct PushConstants {
@@ -34,12 +36,16 @@ public:
     void Init(const gfx::CoreCtx& ctx);
     void Clear(const gfx::CoreCtx& ctx);
 
-    void Run(VkCommandBuffer cmd,
+    void Run(ComputeGraph& graph,
              const gfx::CoreCtx& ctx,
              const gfx::Buffer& items,
              const gfx::Buffer& keys,
              u32 max_value);
 
+    // Allocates the work buffers up front. Needed when runs of different sizes are recorded in the
+    // same command buffer, since growing them would free buffers still in use.
+    void Reserve(const gfx::CoreCtx& ctx, u32 item_count, u32 max_value);
+
 private:
     struct PushConstants {
         VkDeviceAddress input_items;
@@ -48,6 +54,7 @@ private:
         VkDeviceAddress sorted_keys;
         VkDeviceAddress counts;
         u32 item_count;
+        u32 count_size;
     };
 
     ComputePipeline sort_pipeline;
@@ -59,11 +66,83 @@ private:
     gfx::Buffer counts_buffer;
 };
 
+// Sorts keys that were already sorted in the previous run and mostly did not change since. Only the
+// items whose key changed (movers) are sorted, then merged with the ones that kept their place.
+// Items must be reordered with the sorted indices after every run, so that the previously sorted
+// keys describe the current order. When there are more movers than the capacity given by
+// `max_mover_fraction`, a full count sort is done instead. The path is chosen on the GPU, so this
+// requires VK_EXT_conditional_rendering.
+class GPUIncrementalSort {
+public:
+    struct Stats {
+        u32 movers;
+        u32 incremental;
+    };
+
+    void Init(const gfx::CoreCtx& ctx, u32 n, u32 table_size, float max_mover_fraction);
+    void Clear(const gfx::CoreCtx& ctx);
+
+    // Sorts `keys` in place and writes the sorting permutation to `items`. If `gate` is given, the
+    // run is assumed to be inside the block of its first slot, and it only sorts when that is set.
+    void Run(ComputeGraph& graph,
+             const gfx::CoreCtx& ctx,
+             const gfx::Buffer& items,
+             const gfx::Buffer& keys,
+             const GPUPredicate* gate = nullptr);
+
+    // Next run sorts everything, e.g. after the item order was changed externally
+    void ForceFullSort() { force_full = true; }
+    bool FullSortPending() const { return force_full; }
+
+    bool Supported() const { return predicate.Supported(); }
+    Stats LastStats() const;
+
+private:
+    struct PushConstants {
+        VkDeviceAddress keys;
+        VkDeviceAddress items;
+        VkDeviceAddress previous_keys;
+        VkDeviceAddress mover_prefix;
+        VkDeviceAddress mover_keys;
+        VkDeviceAddress mover_particles;
+        VkDeviceAddress mover_order;
+        VkDeviceAddress merged_keys;
+        VkDeviceAddress merged_items;
+        VkDeviceAddress predicates;
+        VkDeviceAddress rebuild;
+        VkDeviceAddress stats;
+        u32 use_rebuild_flag;
+        u32 force_full;
+        u32 capacity;
+        u32 table_size;
+        u32 n;
+    };
+
+    u32 n{0};
+    u32 table_size{0};
+    u32 capacity{0};
+    bool force_full{true};
+
+    ComputePipeline incremental_pipeline;
+    GPUPredicate predicate;
+    GPUCountSort sort;
+    GPUScan gpu_scan;
+
+    gfx::Buffer previous_keys;
+    gfx::Buffer mover_prefix;
+    gfx::Buffer mover_keys;
+    gfx::Buffer mover_particles;
+    gfx::Buffer mover_order;
+    gfx::Buffer merged_keys;
+    gfx::Buffer merged_items;
+    gfx::Buffer stats;
+};
+
 class SpatialOffset {
 public:
     void Init(const gfx::CoreCtx& ctx);
     void Clear(const gfx::CoreCtx& ctx);
-    void Run(VkCommandBuffer cmd,
+    void Run(ComputeGraph& graph,
              const gfx::CoreCtx& ctx,
              bool init,
              const gfx::Buffer& sorted_keys,
@@ -74,6 +153,7 @@ private:
         VkDeviceAddress sorted_keys;
         VkDeviceAddress offsets;
         u32 num_inputs;
+        u32 table_size;
     };
 
     ComputePipeline offset_pipeline;
@@ -103,8 +183,11 @@ public:
 
     void Init(const gfx::CoreCtx& ctx, Config&& cfg);
     void Clear(const gfx::CoreCtx& ctx);
-    void Reorder(VkCommandBuffer cmd, const gfx::CoreCtx& ctx);
+    void Reorder(ComputeGraph& graph, const gfx::CoreCtx& ctx);
+    // Transfer commands, the graph has to be synchronized around them with ComputeGraph::Barrier
     void Copyback(VkCommandBuffer cmd);
+    // Same as Copyback, but done with compute dispatches so it can be skipped by a GPUPredicate
+    void CopybackDispatch(ComputeGraph& graph);
 
 private:
     ComputePipeline reorder_pipeline;
@@ -1,5 +1,9 @@
 #include "spatial_hash.h"
 
+#include <algorithm>
+#include <bit>
+#include <cmath>
+
 #include "gfx/common.h"
 #include "gfx/descriptor.h"
 
@@ -14,20 +18,84 @@ struct PushConstants {
 struct UniformData {
     float cell_size;
     VkDeviceAddress spatial_keys;
+    u32 table_mask;
+};
+
+struct DiagnosticsPushConstants {
+    VkDeviceAddress positions;
+    VkDeviceAddress sorted_indices;
+    VkDeviceAddress sorted_keys;
+    VkDeviceAddress offsets;
+    VkDeviceAddress stats;
+    float cell_size;
+    u32 n;
+};
+
+enum DiagnosticsKernels : u32 {
+    KernelResetHashStats = 0,
+    KernelHashDiagnostics,
+};
+
+struct DisplacementPushConstants {
+    VkDeviceAddress positions;
+    VkDeviceAddress reference_positions;
+    VkDeviceAddress max_sqr_displacement;
+    VkDeviceAddress rebuild;
+    float skin;
+    u32 force_rebuild;
+    u32 n;
+};
+
+struct CellTilesPushConstants {
+    VkDeviceAddress sorted_keys;
+    VkDeviceAddress tile_starts;
+    VkDeviceAddress bucket_ends;
+    VkDeviceAddress tile_dispatch;
+    u32 n;
+};
+
+enum CellTilesKernels : u32 {
+    KernelResetCellTiles = 0,
+    KernelBuildCellTiles,
+};
+
+enum DisplacementKernels : u32 {
+    KernelMaxDisplacement = 0,
+    KernelUpdateRebuildFlag,
+    KernelStoreReferencePositions,
 };
 
 }  // namespace
 
-void SpatialHash::Init(const gfx::CoreCtx& ctx, u32 n, float cell_size) {
+void SpatialHash::Init(const gfx::CoreCtx& ctx, u32 n, float radius, const Config& config) {
     this->n = n;
+    this->radius = radius;
+    this->config = config;
+
+    const auto min_table_size =
+        config.table_size > 0 ? config.table_size
+                              : (u32)std::ceil((float)n / std::max(config.load_factor, 1e-3f));
+    table_size = std::bit_ceil(std::max(min_table_size, 1u));
+    fmt::println("Spatial hash table size: {} ({:.2f} particles per bucket)", table_size,
+                 (float)n / (float)table_size);
 
     spatial_keys = CreateDataBuffer<u32>(ctx, n);
     spatial_indices = CreateDataBuffer<u32>(ctx, n);
-    spatial_offsets = CreateDataBuffer<u32>(ctx, n);
+    spatial_offsets = CreateDataBuffer<u32>(ctx, table_size);
 
     sort.Init(ctx);
     offset.Init(ctx);
 
+    if (UsesIncrementalSort()) {
+        incremental_sort.Init(ctx, n, table_size, config.incremental_sort_threshold);
+        if (!incremental_sort.Supported()) {
+            fmt::println(
+                "Incremental sort requires VK_EXT_conditional_rendering, a full sort will be used");
+            incremental_sort.Clear(ctx);
+            this->config.incremental_sort_threshold = 0.0f;
+        }
+    }
+
     desc_info.push_back({
         .type = gfx::DescriptorManager::DescType::Uniform,
         .buffer = {.data_buffer = gfx::Buffer::Create(ctx, sizeof(UniformData),
@@ -35,11 +103,6 @@ void SpatialHash::Init(const gfx::CoreCtx& ctx, u32 n, float cell_size) {
     });
 
     spatial_hash_desc.Init(ctx, desc_info);
-    auto uniforms = UniformData{
-        .cell_size = cell_size,
-        .spatial_keys = spatial_keys.device_addr,
-    };
-    spatial_hash_desc.SetUniformData(0, &uniforms);
 
     spatial_hash_pipeline.Init(ctx,
                                {.shader_path = "shaders/compiled/update_spatial_hash.slang.spv",
@@ -47,19 +110,156 @@ void SpatialHash::Init(const gfx::CoreCtx& ctx, u32 n, float cell_size) {
                                 .push_const_size = sizeof(PushConstants),
                                 .set = spatial_hash_desc.Set(),
                                 .layout = spatial_hash_desc.Layout()});
+
+    if (UsesCellTiles()) {
+        tile_starts = CreateDataBuffer<u32>(ctx, n);
+        bucket_ends = CreateDataBuffer<u32>(ctx, table_size);
+        tile_dispatch = gfx::Buffer::Create(
+            ctx, sizeof(VkDispatchIndirectCommand),
+            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT |
+                VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT,
+            VMA_MEMORY_USAGE_AUTO_PREFER_DEVICE);
+
+        cell_tiles_pipeline.Init(ctx, {.shader_path = "shaders/compiled/cell_tiles.slang.spv",
+                                       .kernels = {"ResetCellTiles", "BuildCellTiles"},
+                                       .push_const_size = sizeof(CellTilesPushConstants)});
+    }
+
+    diagnostics = gfx::CreateReadbackBuffer<Diagnostics>(ctx, 1);
+    *(Diagnostics*)diagnostics.Map() = {};
+
+    diagnostics_pipeline.Init(ctx, {.shader_path = "shaders/compiled/hash_diagnostics.slang.spv",
+                                    .kernels = {"ResetHashStats", "HashDiagnostics"},
+                                    .push_const_size = sizeof(DiagnosticsPushConstants)});
+
+    rebuild_predicate.Init(ctx);
+
+    if (rebuild_predicate.Supported()) {
+        reference_positions = CreateDataBuffer<glm::vec3>(ctx, n);
+        max_displacement = CreateDataBuffer<u32>(ctx, 1);
+
+        displacement_pipeline.Init(
+            ctx, {.shader_path = "shaders/compiled/displacement.slang.spv",
+                  .kernels = {"MaxDisplacement", "UpdateRebuildFlag", "StoreReferencePositions"},
+                  .push_const_size = sizeof(DisplacementPushConstants)});
+    } else if (UsesVerletSkin()) {
+        fmt::println("Verlet skin requires VK_EXT_conditional_rendering, it will be ignored");
+        this->config.verlet_skin = 0.0f;
+    }
+
+    UpdateUniforms();
 }
 
-void SpatialHash::Run(const gfx::CoreCtx& ctx, VkCommandBuffer cmd, VkDeviceAddress positions) {
+void SpatialHash::Run(const gfx::CoreCtx& ctx, ComputeGraph& graph, VkDeviceAddress positions) {
     auto pc = PushConstants{
         .positions = positions,
         .n_particles = n,
     };
 
-    spatial_hash_pipeline.Compute(cmd, 0, {n / 256 + 1, 1, 1}, &pc);
-    ComputeToComputePipelineBarrier(cmd);
-    sort.Run(cmd, ctx, spatial_indices, spatial_keys, n - 1);
-    ComputeToComputePipelineBarrier(cmd);
-    offset.Run(cmd, ctx, true, spatial_keys, spatial_offsets);
+    const auto position_range = ComputeGraph::Range{positions, n * sizeof(glm::vec3)};
+
+    graph.Dispatch(spatial_hash_pipeline, 0, {n / 256 + 1, 1, 1}, &pc, {position_range},
+                   {spatial_keys});
+
+    if (UsesIncrementalSort()) {
+        const auto* gate = UsesVerletSkin() ? &rebuild_predicate : nullptr;
+        incremental_sort.Run(graph, ctx, spatial_indices, spatial_keys, gate);
+    } else {
+        sort.Run(graph, ctx, spatial_indices, spatial_keys, table_size - 1);
+    }
+
+    offset.Run(graph, ctx, true, spatial_keys, spatial_offsets);
+
+    if (UsesCellTiles()) {
+        auto tiles_pc = CellTilesPushConstants{
+            .sorted_keys = spatial_keys.device_addr,
+            .tile_starts = tile_starts.device_addr,
+            .bucket_ends = bucket_ends.device_addr,
+            .tile_dispatch = tile_dispatch.device_addr,
+            .n = n,
+        };
+
+        graph.Dispatch(cell_tiles_pipeline, KernelResetCellTiles, {1, 1, 1}, &tiles_pc, {},
+                       {tile_dispatch});
+        graph.Dispatch(cell_tiles_pipeline, KernelBuildCellTiles, {n / 256 + 1, 1, 1}, &tiles_pc,
+                       {spatial_keys}, {tile_dispatch, tile_starts, bucket_ends});
+    }
+
+    if (diagnostics_enabled) {
+        auto diagnostics_pc = DiagnosticsPushConstants{
+            .positions = positions,
+            .sorted_indices = spatial_indices.device_addr,
+            .sorted_keys = spatial_keys.device_addr,
+            .offsets = spatial_offsets.device_addr,
+            .stats = diagnostics.device_addr,
+            .cell_size = CellSize(),
+            .n = n,
+        };
+
+        graph.Dispatch(diagnostics_pipeline, KernelResetHashStats, {1, 1, 1}, &diagnostics_pc, {},
+                       {diagnostics});
+        graph.Dispatch(diagnostics_pipeline, KernelHashDiagnostics, {n / 256 + 1, 1, 1},
+                       &diagnostics_pc,
+                       {position_range, spatial_indices, spatial_keys, spatial_offsets},
+                       {diagnostics});
+    }
+}
+
+std::vector<ComputeGraph::Range> SpatialHash::NeighborSearchRanges() const {
+    return {spatial_keys,        spatial_offsets, spatial_indices,
+            reference_positions, tile_starts,     bucket_ends};
+}
+
+SpatialHash::Diagnostics SpatialHash::LastDiagnostics() const {
+    diagnostics.Invalidate();
+    return *(Diagnostics*)diagnostics.Map();
+}
+
+void SpatialHash::BeginRebuild(ComputeGraph& graph, VkDeviceAddress positions) {
+    if (!UsesVerletSkin())
+        return;
+
+    auto pc = DisplacementPushConstants{
+        .positions = positions,
+        .reference_positions = reference_positions.device_addr,
+        .max_sqr_displacement = max_displacement.device_addr,
+        .rebuild = rebuild_predicate.Addr(),
+        .skin = config.verlet_skin,
+        .force_rebuild = force_rebuild,
+        .n = n,
+    };
+
+    force_rebuild = false;
+
+    graph.Dispatch(displacement_pipeline, KernelMaxDisplacement, {n / 256 + 1, 1, 1}, &pc,
+                   {{positions, n * sizeof(glm::vec3)}, reference_positions}, {max_displacement});
+    graph.Dispatch(displacement_pipeline, KernelUpdateRebuildFlag, {1, 1, 1}, &pc, {},
+                   {max_displacement, {rebuild_predicate.Addr(), sizeof(u32)}});
+
+    graph.Flush();
+    rebuild_predicate.Begin(graph.Cmd());
+}
+
+void SpatialHash::EndRebuild(ComputeGraph& graph, VkDeviceAddress positions) {
+    if (!UsesVerletSkin())
+        return;
+
+    auto pc = DisplacementPushConstants{
+        .positions = positions,
+        .reference_positions = reference_positions.device_addr,
+        .n = n,
+    };
+
+    graph.Dispatch(displacement_pipeline, KernelStoreReferencePositions, {n / 256 + 1, 1, 1}, &pc,
+                   {{positions, n * sizeof(glm::vec3)}}, {reference_positions});
+
+    graph.Flush();
+    rebuild_predicate.End(graph.Cmd());
+}
+
+bool SpatialHash::HasPendingReset() const {
+    return (UsesVerletSkin() && force_rebuild) ||
+           (UsesIncrementalSort() && incremental_sort.FullSortPending());
 }
 
 void SpatialHash::Clear(const gfx::CoreCtx& ctx) {
@@ -69,15 +269,43 @@ void SpatialHash::Clear(const gfx::CoreCtx& ctx) {
     spatial_indices.Destroy();
     spatial_offsets.Destroy();
     sort.Clear(ctx);
+    if (UsesIncrementalSort())
+        incremental_sort.Clear(ctx);
     offset.Clear(ctx);
     spatial_hash_pipeline.Clear(ctx);
     spatial_hash_desc.Clear(ctx);
+
+    reference_positions.Destroy();
+    max_displacement.Destroy();
+    tile_starts.Destroy();
+    bucket_ends.Destroy();
+    tile_dispatch.Destroy();
+    cell_tiles_pipeline.Clear(ctx);
+    diagnostics.Destroy();
+    diagnostics_pipeline.Clear(ctx);
+    rebuild_predicate.Clear(ctx);
+    displacement_pipeline.Clear(ctx);
 }
 
 void SpatialHash::SetCellSize(float size) {
+    radius = size;
+    UpdateUniforms();
+}
+
+void SpatialHash::SetVerletSkin(float skin) {
+    if (!SupportsVerletSkin())
+        return;
+
+    config.verlet_skin = std::max(skin, 0.0f);
+    force_rebuild = true;
+    UpdateUniforms();
+}
+
+void SpatialHash::UpdateUniforms() {
     auto uniforms = UniformData{
-        .cell_size = size,
+        .cell_size = CellSize(),
         .spatial_keys = spatial_keys.device_addr,
+        .table_mask = table_size - 1,
     };
     spatial_hash_desc.SetUniformData(0, &uniforms);
 }
@@ -1,35 +1,115 @@
 #pragma once
 
+#include "compute_graph.h"
 #include "compute_pipeline.h"
 #include "gfx/common.h"
 #include "gfx/descriptor.h"
+#include "predicate.h"
 #include "sort.h"
 
 namespace vfs {
 class SpatialHash {
 public:
-    void Init(const gfx::CoreCtx& ctx, u32 n, float cell_size);
-    void Run(const gfx::CoreCtx& ctx, VkCommandBuffer cmd, VkDeviceAddress positions);
+    struct Config {
+        // Number of buckets, rounded up to a power of two. Zero derives it from the load factor.
+        u32 table_size{0};
+        // Particles per bucket used to size the table when table_size is not given
+        float load_factor{1.0f};
+        // Extra distance added to the cell size. When larger than zero the cell structure is kept
+        // across substeps and only rebuilt once a particle may have crossed the skin.
+        float verlet_skin{0.0f};
+        // Largest fraction of particles that may change cell between rebuilds for the keys to be
+        // re-sorted incrementally from the previous order. Zero always does a full sort.
+        float incremental_sort_threshold{0.0f};
+        // Capacity of the per-particle neighbor list built after each rebuild, for models that
+        // support it. Zero walks the hash cells in every kernel instead.
+        u32 max_neighbors{0};
+        // Build the list of non-empty buckets dispatched by the cell-tiled kernels
+        bool cell_tiles{false};
+    };
+
+    struct Diagnostics {
+        u32 occupied_buckets;
+        u32 colliding_particles;
+        u32 max_chain_length;
+    };
+
+    void Init(const gfx::CoreCtx& ctx, u32 n, float radius, const Config& config = {});
+    void Run(const gfx::CoreCtx& ctx, ComputeGraph& graph, VkDeviceAddress positions);
     void Clear(const gfx::CoreCtx& ctx);
 
+    // Commands recorded between BeginRebuild and EndRebuild only run when the hash has to be
+    // rebuilt. Without a Verlet skin the hash is rebuilt every time. Run must be recorded in
+    // between, and the particles reordered with the sorted indices before EndRebuild.
+    void BeginRebuild(ComputeGraph& graph, VkDeviceAddress positions);
+    void EndRebuild(ComputeGraph& graph, VkDeviceAddress positions);
+    void ForceRebuild() { force_rebuild = true; }
+    // True while the next recorded run differs from the following ones because of a one-off
+    // request, such as a forced rebuild or full sort
+    bool HasPendingReset() const;
+
     VkDeviceAddress SpatialKeysAddr() const { return spatial_keys.device_addr; }
     VkDeviceAddress SpatialIndicesAddr() const { return spatial_indices.device_addr; }
     VkDeviceAddress SpatialOffsetsAddr() const { return spatial_offsets.device_addr; }
+    VkDeviceAddress ReferencePositionsAddr() const { return reference_positions.device_addr; }
+    VkDeviceAddress TileStartsAddr() const { return tile_starts.device_addr; }
+    VkDeviceAddress BucketEndsAddr() const { return bucket_ends.device_addr; }
+    // VkDispatchIndirectCommand with one workgroup per non-empty bucket
+    const gfx::Buffer& TileDispatchBuffer() const { return tile_dispatch; }
+    // Buffers read by kernels that search neighbors through the hash
+    std::vector<ComputeGraph::Range> NeighborSearchRanges() const;
 
     void SetCellSize(float size);
+    void SetVerletSkin(float skin);
+    // Measures table occupancy and collisions at every rebuild while enabled
+    void SetDiagnostics(bool enable) { diagnostics_enabled = enable; }
+
+    float CellSize() const { return radius + config.verlet_skin; }
+    float VerletSkin() const { return config.verlet_skin; }
+    bool UsesVerletSkin() const { return config.verlet_skin > 0.0f; }
+    bool SupportsVerletSkin() const { return rebuild_predicate.Supported(); }
+
+    u32 TableSize() const { return table_size; }
+    bool DiagnosticsEnabled() const { return diagnostics_enabled; }
+    Diagnostics LastDiagnostics() const;
+
+    bool UsesCellTiles() const { return config.cell_tiles; }
+    bool UsesIncrementalSort() const { return config.incremental_sort_threshold > 0.0f; }
+    GPUIncrementalSort::Stats IncrementalSortStats() const { return incremental_sort.LastStats(); }
 
 private:
     u32 n{0};
+    u32 table_size{0};
+    float radius{0.0f};
+    Config config;
+    bool force_rebuild{true};
 
     std::vector<gfx::DescriptorManager::DescriptorInfo> desc_info;
     gfx::DescriptorManager spatial_hash_desc;
     ComputePipeline spatial_hash_pipeline;
 
     GPUCountSort sort;
+    GPUIncrementalSort incremental_sort;
     SpatialOffset offset;
 
     gfx::Buffer spatial_keys;
     gfx::Buffer spatial_indices;
     gfx::Buffer spatial_offsets;
+
+    ComputePipeline displacement_pipeline;
+    GPUPredicate rebuild_predicate;
+    gfx::Buffer reference_positions;
+    gfx::Buffer max_displacement;
+
+    ComputePipeline cell_tiles_pipeline;
+    gfx::Buffer tile_starts;
+    gfx::Buffer bucket_ends;
+    gfx::Buffer tile_dispatch;
+
+    ComputePipeline diagnostics_pipeline;
+    gfx::Buffer diagnostics;
+    bool diagnostics_enabled{false};
+
+    void UpdateUniforms();
 };
 }  // namespace vfs
@@ -0,0 +1,70 @@
+#include "command_cache.h"
+
+#include "vk_util.h"
+
+namespace gfx {
+void CommandCache::Init(const CoreCtx& ctx) {
+    auto command_pool_info = vk::util::CommandPoolCreateInfo(ctx.compute_queue_family);
+    VK_CHECK(vkCreateCommandPool(ctx.device, &command_pool_info, NULL, &cmd_pool));
+}
+
+void CommandCache::Clear(const CoreCtx& ctx) {
+    if (cmd_pool)
+        vkDestroyCommandPool(ctx.device, cmd_pool, NULL);
+
+    cmd_pool = VK_NULL_HANDLE;
+    cmd_buffer = VK_NULL_HANDLE;
+    retired.clear();
+}
+
+void CommandCache::BeginFrame(const CoreCtx& ctx) {
+    for (auto& r : retired) {
+        if (r.frames_left > 0)
+            r.frames_left--;
+
+        if (r.frames_left == 0)
+            vkFreeCommandBuffers(ctx.device, cmd_pool, 1, &r.cmd_buffer);
+    }
+
+    std::erase_if(retired, [](const Retired& r) { return r.frames_left == 0; });
+}
+
+void CommandCache::Record(const CoreCtx& ctx,
+                          const std::function<void(VkCommandBuffer)>& function) {
+    Invalidate();
+
+    auto cmd_alloc_info =
+        vk::util::CommandBufferAllocateInfo(cmd_pool, 1, VK_COMMAND_BUFFER_LEVEL_SECONDARY);
+    VK_CHECK(vkAllocateCommandBuffers(ctx.device, &cmd_alloc_info, &cmd_buffer));
+
+    // Compute only, so nothing is inherited from a render pass
+    auto inheritance_info = VkCommandBufferInheritanceInfo{
+        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO,
+    };
+
+    // Frames in flight may execute the same buffer concurrently
+    auto cmd_begin_info =
+        vk::util::CommandBufferBeginInfo(VK_COMMAND_BUFFER_USAGE_SIMULTANEOUS_USE_BIT);
+    cmd_begin_info.pInheritanceInfo = &inheritance_info;
+
+    VK_CHECK(vkBeginCommandBuffer(cmd_buffer, &cmd_begin_info));
+    function(cmd_buffer);
+    VK_CHECK(vkEndCommandBuffer(cmd_buffer));
+
+    record_count++;
+}
+
+void CommandCache::Execute(VkCommandBuffer cmd) const {
+    if (cmd_buffer)
+        vkCmdExecuteCommands(cmd, 1, &cmd_buffer);
+}
+
+void CommandCache::Invalidate() {
+    if (!cmd_buffer)
+        return;
+
+    // The current frame may have executed it already, besides the ones in flight
+    retired.push_back({.cmd_buffer = cmd_buffer, .frames_left = FRAME_COUNT + 1});
+    cmd_buffer = VK_NULL_HANDLE;
+}
+}  // namespace gfx
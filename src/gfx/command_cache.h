@@ -0,0 +1,38 @@
+#pragma once
+
+#include <functional>
+#include <vector>
+
+#include "gfx/common.h"
+
+namespace gfx {
+// Secondary command buffer recorded once and executed every frame until it is invalidated. A
+// replaced buffer is only freed after the frames that may still be executing it have finished.
+class CommandCache {
+public:
+    // Recorded buffers can be executed from primaries of ctx.compute_queue_family
+    void Init(const CoreCtx& ctx);
+    void Clear(const CoreCtx& ctx);
+
+    // Must be called once per frame, before Record or Execute
+    void BeginFrame(const CoreCtx& ctx);
+
+    void Record(const CoreCtx& ctx, const std::function<void(VkCommandBuffer)>& function);
+    void Execute(VkCommandBuffer cmd) const;
+    void Invalidate();
+
+    bool Valid() const { return cmd_buffer != VK_NULL_HANDLE; }
+    u32 RecordCount() const { return record_count; }
+
+private:
+    struct Retired {
+        VkCommandBuffer cmd_buffer;
+        u32 frames_left;
+    };
+
+    VkCommandPool cmd_pool{VK_NULL_HANDLE};
+    VkCommandBuffer cmd_buffer{VK_NULL_HANDLE};
+    std::vector<Retired> retired;
+    u32 record_count{0};
+};
+}  // namespace gfx
@@ -15,6 +15,11 @@ void* Buffer::Map() const {
     vmaMapMemory(allocator, alloc, &mapped);
     return mapped;
 }
+
+void Buffer::Invalidate() const {
+    vmaInvalidateAllocation(allocator, alloc, 0, VK_WHOLE_SIZE);
+}
+
 void Buffer::Unmap() {
     if (mapped) {
         vmaUnmapMemory(allocator, alloc);
@@ -25,7 +30,8 @@ void Buffer::Unmap() {
 Buffer Buffer::Create(const CoreCtx& ctx,
                       size_t size,
                       VkBufferUsageFlags usage,
-                      VmaMemoryUsage mem_usage) {
+                      VmaMemoryUsage mem_usage,
+                      VmaAllocationCreateFlags flags) {
     auto buffer_info = VkBufferCreateInfo{
         .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
         .pNext = NULL,
@@ -33,10 +39,17 @@ Buffer Buffer::Create(const CoreCtx& ctx,
         .usage = usage,
     };
 
+    // Buffers may be written by the simulation on the compute queue and read by the renderer
+    const u32 queue_families[] = {ctx.queue_family, ctx.compute_queue_family};
+    if (ctx.compute_queue_family != ctx.queue_family) {
+        buffer_info.sharingMode = VK_SHARING_MODE_CONCURRENT;
+        buffer_info.queueFamilyIndexCount = 2;
+        buffer_info.pQueueFamilyIndices = queue_families;
+    }
+
     auto vma_alloc_info = VmaAllocationCreateInfo{
         .usage = mem_usage,
-        // TODO: check if it's necessary to use VMA_ALLOCATION_CREATE_HOST_ACCESS_RANDOM_BIT
-        .flags = VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT,
+        .flags = flags,
     };
 
     Buffer buffer{};
@@ -49,6 +49,15 @@ struct CoreCtx {
     VkPhysicalDevice chosen_gpu;
     VkSurfaceKHR surface;
     VmaAllocator allocator;
+    u32 queue_family;
+    // Family of the queue the simulation is submitted to. Same as queue_family when the device has
+    // no separate compute queue or async compute is disabled.
+    u32 compute_queue_family;
+    // Shared by every pipeline, persisted across runs
+    VkPipelineCache pipeline_cache{VK_NULL_HANDLE};
+
+    // Optional device features
+    bool conditional_rendering{false};
 };
 
 struct Image {
@@ -81,6 +90,7 @@ struct Buffer {
     void* GetMapped();
     void* Map() const;
     void Unmap();
+    void Invalidate() const;
     void SetDescriptorInfo(VkDeviceSize size, VkDeviceSize offset);
 
     template <typename T>
@@ -88,10 +98,12 @@ struct Buffer {
         memcpy(Map(), data.data(), data.size_bytes());
     }
 
-    static Buffer Create(const CoreCtx& ctx,
-                         size_t size,
-                         VkBufferUsageFlags usage,
-                         VmaMemoryUsage mem_usage = VMA_MEMORY_USAGE_AUTO);
+    static Buffer Create(
+        const CoreCtx& ctx,
+        size_t size,
+        VkBufferUsageFlags usage,
+        VmaMemoryUsage mem_usage = VMA_MEMORY_USAGE_AUTO,
+        VmaAllocationCreateFlags flags = VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT);
     void Destroy();
 };
 
@@ -105,4 +117,15 @@ gfx::Buffer CreateDataBuffer(const gfx::CoreCtx& ctx, size_t n) {
         VMA_MEMORY_USAGE_AUTO_PREFER_DEVICE);
 }
 
+// Small buffer written by shaders and read on the CPU without waiting, e.g. for statistics.
+template <typename T>
+gfx::Buffer CreateReadbackBuffer(const gfx::CoreCtx& ctx, size_t n) {
+    const auto sz = sizeof(T) * n;
+    return gfx::Buffer::Create(
+        ctx, sz,
+        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT |
+            VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT,
+        VMA_MEMORY_USAGE_AUTO_PREFER_HOST, VMA_ALLOCATION_CREATE_HOST_ACCESS_RANDOM_BIT);
+}
+
 }  // namespace gfx
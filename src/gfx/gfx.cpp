@@ -16,7 +16,7 @@
 
 namespace gfx {
 
-u32 Device::CurrentFrameIndex() {
+u32 Device::CurrentFrameIndex() const {
     return frame_number % gfx::FRAME_COUNT;
 }
 
@@ -36,33 +36,89 @@ VkCommandBuffer Device::BeginFrame() {
 
     VK_CHECK(vkBeginCommandBuffer(cmd, &cmd_begin_info));
 
-    used_timestamps = 0;
-    vkCmdResetQueryPool(cmd, query_pool_timestamps, 0, (u32)time_stamps.size());
-
     return cmd;
 }
 
-void Device::SetTopTimestamp(VkCommandBuffer cmd, u32 id) {
-    vkCmdWriteTimestamp2(cmd, VK_PIPELINE_STAGE_2_TOP_OF_PIPE_BIT, query_pool_timestamps, id);
-    used_timestamps++;
+VkCommandBuffer Device::BeginCompute() {
+    // The command buffer was last submitted FRAME_COUNT frames ago
+    if (frame_number >= gfx::FRAME_COUNT)
+        WaitForCompute(frame_number - gfx::FRAME_COUNT + 1);
+
+    auto cmd = compute_frames[CurrentFrameIndex()].cmd_buffer;
+    VK_CHECK(vkResetCommandBuffer(cmd, 0));
+
+    auto cmd_begin_info =
+        vk::util::CommandBufferBeginInfo(VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT);
+
+    VK_CHECK(vkBeginCommandBuffer(cmd, &cmd_begin_info));
+    return cmd;
 }
 
-void Device::SetBottomTimestamp(VkCommandBuffer cmd, u32 id) {
-    vkCmdWriteTimestamp2(cmd, VK_PIPELINE_STAGE_2_BOTTOM_OF_PIPE_BIT, query_pool_timestamps, id);
-    used_timestamps++;
+void Device::SubmitCompute(VkCommandBuffer cmd) {
+    VK_CHECK(vkEndCommandBuffer(cmd));
+
+    const u64 value = frame_number + 1;
+    auto cmd_submit_info = vk::util::CommandBufferSubmitInfo(cmd);
+    auto signal_info = vk::util::SemaphoreSubmitInfo(VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT,
+                                                     compute_timeline, value);
+
+    // Whatever is written here for the current frame slot may still be read by the frame
+    // rendered FRAME_COUNT frames ago
+    const bool wait_render = frame_number >= gfx::FRAME_COUNT;
+    auto wait_info = vk::util::SemaphoreSubmitInfo(VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT,
+                                                   graphics_timeline,
+                                                   wait_render ? value - gfx::FRAME_COUNT : 0);
+
+    auto submit =
+        vk::util::SubmitInfo2(&cmd_submit_info, &signal_info, wait_render ? &wait_info : NULL);
+    VK_CHECK(vkQueueSubmit2(compute_queue, 1, &submit, VK_NULL_HANDLE));
+
+    compute_submitted = value;
 }
 
-std::span<u64> Device::GetTimestamps() {
-    vkGetQueryPoolResults(core.device, query_pool_timestamps, 0, used_timestamps,
-                          time_stamps.size() * sizeof(u64), time_stamps.data(), sizeof(u64),
-                          VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WAIT_BIT);
-    return std::span<u64>(time_stamps.data(), used_timestamps);
+void Device::WaitForCompute(u64 value) const {
+    // Frames may skip the compute submit, so only values that were signaled can be waited on
+    value = std::min(value, compute_submitted);
+    if (!async_compute || value == 0)
+        return;
+
+    auto wait_info = VkSemaphoreWaitInfo{
+        .sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO,
+        .semaphoreCount = 1,
+        .pSemaphores = &compute_timeline,
+        .pValues = &value,
+    };
+
+    // Large batches, or software implementations, can take longer than any fixed timeout
+    VK_CHECK(vkWaitSemaphores(core.device, &wait_info, UINT64_MAX));
 }
 
 VkExtent2D Device::GetSwapchainExtent() {
     return swapchain.GetExtent();
 };
 
+void Device::SetPresentMode(VkPresentModeKHR mode) {
+    vkDeviceWaitIdle(core.device);
+    swapchain.Destroy(core);
+
+    int w, h;
+    SDL_GetWindowSize(window, &w, &h);
+
+    swapchain.Create(core, w, h, mode);
+    swapchain.InitSyncStructs(core);
+}
+
+std::vector<VkPresentModeKHR> Device::SupportedPresentModes() const {
+    u32 count = 0;
+    VK_CHECK(vkGetPhysicalDeviceSurfacePresentModesKHR(core.chosen_gpu, core.surface, &count,
+                                                       nullptr));
+
+    auto modes = std::vector<VkPresentModeKHR>(count);
+    VK_CHECK(vkGetPhysicalDeviceSurfacePresentModesKHR(core.chosen_gpu, core.surface, &count,
+                                                       modes.data()));
+    return modes;
+}
+
 void Device::EndFrame(VkCommandBuffer cmd, const Image& draw_img) {
     u32 swapchain_img_index;
     auto swapchain_img =
@@ -108,7 +164,21 @@ void Device::EndFrame(VkCommandBuffer cmd, const Image& draw_img) {
         vk::util::TransitionImage(cmd, swapchain_img, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
                                   VK_IMAGE_LAYOUT_PRESENT_SRC_KHR);
         VK_CHECK(vkEndCommandBuffer(cmd));
-        swapchain.SubmitAndPresent(cmd, graphics_queue, CurrentFrameIndex(), swapchain_img_index);
+
+        const u64 value = frame_number + 1;
+        auto waits = std::vector<VkSemaphoreSubmitInfo>{};
+        auto signals = std::vector<VkSemaphoreSubmitInfo>{};
+
+        if (async_compute) {
+            signals.push_back(vk::util::SemaphoreSubmitInfo(VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT,
+                                                            graphics_timeline, value));
+            if (compute_submitted == value)
+                waits.push_back(vk::util::SemaphoreSubmitInfo(VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT,
+                                                              compute_timeline, value));
+        }
+
+        swapchain.SubmitAndPresent(cmd, graphics_queue, CurrentFrameIndex(), swapchain_img_index,
+                                   waits, signals);
     }
 
     frame_number++;
@@ -126,6 +196,29 @@ void Device::InitCommandBuffers() {
     }
 }
 
+void Device::InitComputeSync() {
+    auto timeline_info = VkSemaphoreTypeCreateInfo{
+        .sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO,
+        .semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE,
+        .initialValue = 0,
+    };
+
+    auto semaphore_create_info = vk::util::SemaphoreCreateInfo();
+    semaphore_create_info.pNext = &timeline_info;
+
+    VK_CHECK(vkCreateSemaphore(core.device, &semaphore_create_info, NULL, &compute_timeline));
+    VK_CHECK(vkCreateSemaphore(core.device, &semaphore_create_info, NULL, &graphics_timeline));
+
+    auto command_pool_info = vk::util::CommandPoolCreateInfo(
+        compute_queue_family, VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT);
+
+    for (auto& frame : compute_frames) {
+        VK_CHECK(vkCreateCommandPool(core.device, &command_pool_info, NULL, &frame.cmd_pool));
+        auto cmd_buf_alloc_info = vk::util::CommandBufferAllocateInfo(frame.cmd_pool, 1);
+        VK_CHECK(vkAllocateCommandBuffers(core.device, &cmd_buf_alloc_info, &frame.cmd_buffer));
+    }
+}
+
 void Device::Init(const Config& config) {
     vkb::InstanceBuilder builder;
     auto instance_result = builder.set_app_name(config.name)
@@ -144,12 +237,15 @@ void Device::Init(const Config& config) {
         .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_3_FEATURES};
     features13.dynamicRendering = true;
     features13.synchronization2 = true;
+    // Workgroup sizes given by specialization constants
+    features13.maintenance4 = true;
 
     auto features12 = VkPhysicalDeviceVulkan12Features{
         .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES};
     features12.bufferDeviceAddress = true;
     features12.descriptorIndexing = true;
     features12.scalarBlockLayout = true;
+    features12.timelineSemaphore = true;
 
     auto features11 = VkPhysicalDeviceVulkan11Features{
         .shaderDrawParameters = true,
@@ -169,6 +265,16 @@ void Device::Init(const Config& config) {
                                .select()
                                .value();
 
+    // Used to skip blocks of simulation dispatches based on GPU-written predicates
+    auto conditional_rendering_features = VkPhysicalDeviceConditionalRenderingFeaturesEXT{
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_CONDITIONAL_RENDERING_FEATURES_EXT,
+        .conditionalRendering = true,
+    };
+
+    core.conditional_rendering =
+        physical_device.enable_extension_if_present(VK_EXT_CONDITIONAL_RENDERING_EXTENSION_NAME) &&
+        physical_device.enable_extension_features_if_present(conditional_rendering_features);
+
     auto device_builder = vkb::DeviceBuilder{physical_device};
     auto vkb_device = device_builder.build().value();
 
@@ -200,6 +306,24 @@ void Device::Init(const Config& config) {
 
     graphics_queue = vkb_device.get_queue(vkb::QueueType::graphics).value();
     graphics_queue_family = vkb_device.get_queue_index(vkb::QueueType::graphics).value();
+    core.queue_family = graphics_queue_family;
+
+    compute_queue = graphics_queue;
+    compute_queue_family = graphics_queue_family;
+    async_compute = config.async_compute;
+
+    // Only a family without graphics is returned for compute
+    if (async_compute) {
+        if (auto family = vkb_device.get_queue_index(vkb::QueueType::compute)) {
+            compute_queue_family = family.value();
+            compute_queue = vkb_device.get_queue(vkb::QueueType::compute).value();
+        }
+
+        fmt::println("Async compute: {}", HasComputeQueue() ? "dedicated compute queue"
+                                                            : "graphics queue (no compute queue)");
+    }
+
+    core.compute_queue_family = compute_queue_family;
 
     auto allocator_create_info = VmaAllocatorCreateInfo{
         .physicalDevice = core.chosen_gpu,
@@ -210,27 +334,28 @@ void Device::Init(const Config& config) {
 
     vmaCreateAllocator(&allocator_create_info, &core.allocator);
 
+    pipeline_cache.Init(core);
+    core.pipeline_cache = pipeline_cache.Handle();
+
+    window = config.window;
+
     int w, h;
-    SDL_GetWindowSize(config.window, &w, &h);
+    SDL_GetWindowSize(window, &w, &h);
 
-    swapchain.Create(core, w, h);
+    swapchain.Create(core, w, h, config.present_mode);
     swapchain.InitSyncStructs(core);
     swapchain_img_clear_color = glm::vec4(0.0f);
 
     InitCommandBuffers();
+    if (async_compute)
+        InitComputeSync();
 
     immediate_runner.Init(core, graphics_queue_family, graphics_queue);
-
-    time_stamps.resize(6);
-    auto query_pool_info = VkQueryPoolCreateInfo{
-        .sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO,
-        .queryType = VK_QUERY_TYPE_TIMESTAMP,
-        .queryCount = (u32)time_stamps.size(),
-    };
-    VK_CHECK(vkCreateQueryPool(core.device, &query_pool_info, nullptr, &query_pool_timestamps));
 }
 
 void Device::ImmediateSubmit(std::function<void(VkCommandBuffer)>&& function) const {
+    // Runs on the graphics queue and may touch buffers the simulation is still writing
+    WaitForCompute(compute_submitted);
     immediate_runner.Submit(core, std::move(function));
 }
 
@@ -245,6 +370,18 @@ void Device::Clear() {
         vkDestroyCommandPool(core.device, frame.cmd_pool, NULL);
     }
 
+    if (async_compute) {
+        for (auto& frame : compute_frames) {
+            vkDestroyCommandPool(core.device, frame.cmd_pool, NULL);
+        }
+
+        vkDestroySemaphore(core.device, compute_timeline, NULL);
+        vkDestroySemaphore(core.device, graphics_timeline, NULL);
+    }
+
+    pipeline_cache.Clear(core);
+    core.pipeline_cache = VK_NULL_HANDLE;
+
     vmaDestroyAllocator(core.allocator);
 }
 void Device::SetImageData(gfx::Image& img, void* data, u32 texel_size, bool mip) const {
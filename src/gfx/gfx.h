@@ -10,6 +10,7 @@
 
 #include "gfx/common.h"
 #include "gfx/immediate.h"
+#include "gfx/pipeline_cache.h"
 #include "gfx/swapchain.h"
 #include "vk_mem_alloc.h"
 
@@ -20,6 +21,10 @@ struct Device {
         const char* name;
         bool validation_layers = false;
         SDL_Window* window;
+        VkPresentModeKHR present_mode = VK_PRESENT_MODE_IMMEDIATE_KHR;
+        // Submits the simulation separately from the frame, on a dedicated compute queue when the
+        // device has one and on the graphics queue otherwise
+        bool async_compute = true;
     };
 
     struct FrameData {
@@ -33,12 +38,27 @@ struct Device {
     VkCommandBuffer BeginFrame();
     void EndFrame(VkCommandBuffer cmd, const Image& draw_img);
 
+    // Command buffer of the current frame for the compute queue, only with async compute. Work
+    // submitted with SubmitCompute starts once the frame FRAME_COUNT frames before has been
+    // rendered, so it may overlap the previous frame. The current frame waits for it.
+    VkCommandBuffer BeginCompute();
+    void SubmitCompute(VkCommandBuffer cmd);
+    bool UsesAsyncCompute() const { return async_compute; }
+    bool HasComputeQueue() const { return compute_queue != graphics_queue; }
+
     const CoreCtx& GetCoreCtx() const { return core; }
+    u32 CurrentFrameIndex() const;
     VkQueue GetQueue() const { return graphics_queue; }
     u32 GetQueueFamily() const { return graphics_queue_family; }
     const Swapchain& GetSwapchain() const { return swapchain; }
 
     VkExtent2D GetSwapchainExtent();
+    // Recreates the swapchain, waiting for the device to be idle
+    void SetPresentMode(VkPresentModeKHR mode);
+    std::vector<VkPresentModeKHR> SupportedPresentModes() const;
+
+    const PipelineCache& GetPipelineCache() const { return pipeline_cache; }
+    void SavePipelineCache() const { pipeline_cache.Save(core); }
 
     void ImmediateSubmit(std::function<void(VkCommandBuffer)>&& function) const;
 
@@ -120,28 +140,32 @@ struct Device {
 
     void SetImageData(gfx::Image& img, void* data, u32 texel_size, bool mip = false) const;
 
-    void SetTopTimestamp(VkCommandBuffer cmd, u32 id);
-    void SetBottomTimestamp(VkCommandBuffer cmd, u32 id);
-
-    std::span<u64> GetTimestamps();
-
 private:
     void InitCommandBuffers();
+    void InitComputeSync();
+    void WaitForCompute(u64 value) const;
     FrameData& CurrentFrame();
-    u32 CurrentFrameIndex();
 
     CoreCtx core;
     VkQueue graphics_queue;
     u32 graphics_queue_family;
 
+    VkQueue compute_queue;
+    u32 compute_queue_family;
+    bool async_compute{false};
+    std::array<FrameData, gfx::FRAME_COUNT> compute_frames;
+    // Timeline semaphores signaled with frame_number + 1 once the simulation or the rendering of
+    // that frame has finished
+    VkSemaphore compute_timeline{VK_NULL_HANDLE};
+    VkSemaphore graphics_timeline{VK_NULL_HANDLE};
+    u64 compute_submitted{0};
+
+    SDL_Window* window;
     Swapchain swapchain;
     glm::vec4 swapchain_img_clear_color;
 
-    u32 used_timestamps{0};
-    std::vector<u64> time_stamps;
-    VkQueryPool query_pool_timestamps;
-
     ImmediateRunner immediate_runner;
+    PipelineCache pipeline_cache;
 
     std::array<FrameData, gfx::FRAME_COUNT> frames;
     uint32_t frame_number = 0;
@@ -0,0 +1,100 @@
+#include "pipeline_cache.h"
+
+#include <SDL3/SDL_filesystem.h>
+
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <vector>
+
+#include "vk_util.h"
+
+namespace gfx {
+namespace {
+std::string UUIDString(const u8* uuid) {
+    auto s = std::string{};
+    for (u32 i = 0; i < VK_UUID_SIZE; i++) {
+        s += fmt::format("{:02x}", uuid[i]);
+    }
+    return s;
+}
+
+bool MatchesDevice(const std::vector<char>& data, const VkPhysicalDeviceProperties& props) {
+    auto header = VkPipelineCacheHeaderVersionOne{};
+    if (data.size() < sizeof(header))
+        return false;
+
+    std::memcpy(&header, data.data(), sizeof(header));
+
+    return header.headerSize >= sizeof(header) &&
+           header.headerVersion == VK_PIPELINE_CACHE_HEADER_VERSION_ONE &&
+           header.vendorID == props.vendorID && header.deviceID == props.deviceID &&
+           std::memcmp(header.pipelineCacheUUID, props.pipelineCacheUUID, VK_UUID_SIZE) == 0;
+}
+}  // namespace
+
+void PipelineCache::Init(const CoreCtx& ctx) {
+    VkPhysicalDeviceProperties props;
+    vkGetPhysicalDeviceProperties(ctx.chosen_gpu, &props);
+
+    if (char* pref_path = SDL_GetPrefPath("luihabl", "VkFluidSim")) {
+        path = std::string(pref_path) + "pipeline_cache_" + UUIDString(props.pipelineCacheUUID) +
+               ".bin";
+        SDL_free(pref_path);
+    } else {
+        fmt::println("No preference folder, the pipeline cache will not be saved");
+    }
+
+    auto data = std::vector<char>{};
+    if (!path.empty()) {
+        auto file = std::ifstream(path, std::ios::binary);
+        if (file)
+            data.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    }
+
+    if (!data.empty() && !MatchesDevice(data, props)) {
+        fmt::println("Pipeline cache was written by another device or driver, it will be rebuilt");
+        data.clear();
+    }
+
+    auto cache_info = VkPipelineCacheCreateInfo{
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO,
+        .initialDataSize = data.size(),
+        .pInitialData = data.empty() ? nullptr : data.data(),
+    };
+
+    VK_CHECK(vkCreatePipelineCache(ctx.device, &cache_info, nullptr, &cache));
+    loaded_size = data.size();
+
+    fmt::println("Pipeline cache: {}", Warm() ? fmt::format("{} KB loaded", loaded_size / 1024)
+                                              : std::string("empty"));
+}
+
+void PipelineCache::Save(const CoreCtx& ctx) const {
+    if (!cache || path.empty())
+        return;
+
+    size_t size = 0;
+    VK_CHECK(vkGetPipelineCacheData(ctx.device, cache, &size, nullptr));
+
+    auto data = std::vector<char>(size);
+    VK_CHECK(vkGetPipelineCacheData(ctx.device, cache, &size, data.data()));
+
+    auto file = std::ofstream(path, std::ios::binary | std::ios::trunc);
+    if (!file) {
+        fmt::println("Could not write the pipeline cache to {}", path);
+        return;
+    }
+
+    file.write(data.data(), (std::streamsize)size);
+}
+
+void PipelineCache::Clear(const CoreCtx& ctx) {
+    if (cache) {
+        Save(ctx);
+        vkDestroyPipelineCache(ctx.device, cache, nullptr);
+    }
+
+    cache = VK_NULL_HANDLE;
+}
+}  // namespace gfx
@@ -0,0 +1,28 @@
+#pragma once
+
+#include <string>
+
+#include "gfx/common.h"
+
+namespace gfx {
+// VkPipelineCache shared by every pipeline and persisted in the user's preference folder. The file
+// name holds the pipeline cache UUID of the device, so caches of other devices or drivers are
+// never loaded, and the header is checked again in case the file was replaced.
+class PipelineCache {
+public:
+    void Init(const CoreCtx& ctx);
+    // Writes the cache to disk. Can be called more than once, e.g. once startup has finished.
+    void Save(const CoreCtx& ctx) const;
+    void Clear(const CoreCtx& ctx);
+
+    VkPipelineCache Handle() const { return cache; }
+    // True when the pipelines could be created from the data of a previous run
+    bool Warm() const { return loaded_size > 0; }
+    size_t LoadedSize() const { return loaded_size; }
+
+private:
+    VkPipelineCache cache{VK_NULL_HANDLE};
+    std::string path;
+    size_t loaded_size{0};
+};
+}  // namespace gfx
@@ -9,7 +9,7 @@
 
 namespace gfx {
 
-void Swapchain::Create(const CoreCtx& ctx, u32 w, u32 h) {
+void Swapchain::Create(const CoreCtx& ctx, u32 w, u32 h, VkPresentModeKHR mode) {
     auto sc_builder = vkb::SwapchainBuilder(ctx.chosen_gpu, ctx.device, ctx.surface);
 
     image_format = VK_FORMAT_B8G8R8A8_UNORM;
@@ -18,7 +18,7 @@ void Swapchain::Create(const CoreCtx& ctx, u32 w, u32 h) {
         sc_builder
             .set_desired_format(VkSurfaceFormatKHR{.format = image_format,
                                                    .colorSpace = VK_COLOR_SPACE_SRGB_NONLINEAR_KHR})
-            .set_desired_present_mode(VK_PRESENT_MODE_IMMEDIATE_KHR)
+            .set_desired_present_mode(mode)
             .set_desired_min_image_count(gfx::FRAME_COUNT)
             .set_desired_extent(w, h)
             .add_image_usage_flags(VK_IMAGE_USAGE_TRANSFER_DST_BIT)
@@ -27,6 +27,7 @@ void Swapchain::Create(const CoreCtx& ctx, u32 w, u32 h) {
 
     swapchain = vkb_swapchain.swapchain;
     extent = vkb_swapchain.extent;
+    present_mode = vkb_swapchain.present_mode;
     images = vkb_swapchain.get_images().value();
     image_views = vkb_swapchain.get_image_views().value();
 
@@ -70,7 +71,8 @@ void Swapchain::InitSyncStructs(const CoreCtx& ctx) {
 }
 
 void Swapchain::BeginFrame(const CoreCtx& ctx, u32 frame_index) {
-    VK_CHECK(vkWaitForFences(ctx.device, 1, &frames[frame_index].render_fence, true, ONE_SEC_NS));
+    // The frame may carry a large batch of simulation steps, longer than any fixed timeout
+    VK_CHECK(vkWaitForFences(ctx.device, 1, &frames[frame_index].render_fence, true, UINT64_MAX));
 }
 
 void Swapchain::ResetFences(const CoreCtx& ctx, u32 frame_index) {
@@ -97,14 +99,23 @@ VkExtent2D Swapchain::GetExtent() {
 bool Swapchain::SubmitAndPresent(VkCommandBuffer cmd,
                                  VkQueue queue,
                                  u32 frame_index,
-                                 u32 swapchain_idx) {
+                                 u32 swapchain_idx,
+                                 std::span<const VkSemaphoreSubmitInfo> waits,
+                                 std::span<const VkSemaphoreSubmitInfo> signals) {
     auto& frame = frames[frame_index];
     auto cmd_submit_info = vk::util::CommandBufferSubmitInfo(cmd);
-    auto wait_info = vk::util::SemaphoreSubmitInfo(VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT,
-                                                   frame.swapchain_semaphore);
-    auto signal_info = vk::util::SemaphoreSubmitInfo(VK_PIPELINE_STAGE_2_ALL_GRAPHICS_BIT,
-                                                     render_semaphores[swapchain_idx]);
-    auto submit = vk::util::SubmitInfo2(&cmd_submit_info, &signal_info, &wait_info);
+
+    auto wait_infos = std::vector<VkSemaphoreSubmitInfo>{vk::util::SemaphoreSubmitInfo(
+        VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT, frame.swapchain_semaphore)};
+    wait_infos.insert(wait_infos.end(), waits.begin(), waits.end());
+
+    auto signal_infos = std::vector<VkSemaphoreSubmitInfo>{vk::util::SemaphoreSubmitInfo(
+        VK_PIPELINE_STAGE_2_ALL_GRAPHICS_BIT, render_semaphores[swapchain_idx])};
+    signal_infos.insert(signal_infos.end(), signals.begin(), signals.end());
+
+    auto submit = vk::util::SubmitInfo2(&cmd_submit_info, signal_infos.data(), wait_infos.data());
+    submit.waitSemaphoreInfoCount = (u32)wait_infos.size();
+    submit.signalSemaphoreInfoCount = (u32)signal_infos.size();
 
     VK_CHECK(vkQueueSubmit2(queue, 1, &submit, frame.render_fence));
 
@@ -3,6 +3,7 @@
 #include <VkBootstrap.h>
 #include <vulkan/vulkan.h>
 
+#include <span>
 #include <vector>
 
 #include "gfx/common.h"
@@ -10,7 +11,11 @@
 namespace gfx {
 struct Swapchain {
     void InitSyncStructs(const CoreCtx& ctx);
-    void Create(const CoreCtx& ctx, u32 w, u32 h);
+    // Falls back to FIFO, which is always supported, when the present mode is not available
+    void Create(const CoreCtx& ctx,
+                u32 w,
+                u32 h,
+                VkPresentModeKHR present_mode = VK_PRESENT_MODE_IMMEDIATE_KHR);
     void Destroy(const CoreCtx& ctx);
 
     void BeginFrame(const CoreCtx& ctx, u32 frame_index);
@@ -19,8 +24,15 @@ struct Swapchain {
                              u32* out_swapchain_index = nullptr);
     void ResetFences(const CoreCtx& ctx, u32 frame_index);
     VkExtent2D GetExtent();
-    bool SubmitAndPresent(VkCommandBuffer cmd, VkQueue queue, u32 frame_index, u32 swapchain_idx);
+    // Extra semaphores are waited on and signaled by the submit besides the swapchain ones
+    bool SubmitAndPresent(VkCommandBuffer cmd,
+                          VkQueue queue,
+                          u32 frame_index,
+                          u32 swapchain_idx,
+                          std::span<const VkSemaphoreSubmitInfo> waits = {},
+                          std::span<const VkSemaphoreSubmitInfo> signals = {});
     VkFormat GetFormat() const { return image_format; }
+    VkPresentModeKHR GetPresentMode() const { return present_mode; }
 
 private:
     struct FrameData {
@@ -30,6 +42,7 @@ private:
 
     VkSwapchainKHR swapchain;
     VkFormat image_format;
+    VkPresentModeKHR present_mode;
     std::vector<VkImage> images;
     std::vector<VkImageView> image_views;
     std::array<FrameData, gfx::FRAME_COUNT> frames;
@@ -176,7 +176,7 @@ void GraphicsPipelineBuilder::Clear() {
     shader_stages.resize(0);
 }
 
-VkPipeline GraphicsPipelineBuilder::Build(VkDevice device) {
+VkPipeline GraphicsPipelineBuilder::Build(VkDevice device, VkPipelineCache cache) {
     auto view_port_state = VkPipelineViewportStateCreateInfo{
         .sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO,
         .pNext = NULL,
@@ -228,7 +228,7 @@ VkPipeline GraphicsPipelineBuilder::Build(VkDevice device) {
     };
 
     VkPipeline pipeline;
-    if (vkCreateGraphicsPipelines(device, VK_NULL_HANDLE, 1, &pipeline_info, NULL, &pipeline) !=
+    if (vkCreateGraphicsPipelines(device, cache, 1, &pipeline_info, NULL, &pipeline) !=
         VK_SUCCESS) {
         fmt::println("Failed to create pipeline");
         return VK_NULL_HANDLE;
@@ -397,9 +397,12 @@ GraphicsPipelineBuilder& GraphicsPipelineBuilder::SetDepthTest(bool enable_depth
 VkPipeline BuildComputePipeline(VkDevice device,
                                 VkPipelineLayout layout,
                                 VkShaderModule shader_mod,
-                                const char* entry_point) {
+                                const char* entry_point,
+                                const VkSpecializationInfo* specialization,
+                                VkPipelineCache cache) {
     auto shader =
         PipelineShaderStageCreateInfo(shader_mod, VK_SHADER_STAGE_COMPUTE_BIT, entry_point);
+    shader.pSpecializationInfo = specialization;
 
     auto pipeline_info = VkComputePipelineCreateInfo{
         .sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO,
@@ -409,8 +412,7 @@ VkPipeline BuildComputePipeline(VkDevice device,
     };
 
     VkPipeline pipeline;
-    VK_CHECK(
-        vkCreateComputePipelines(device, VK_NULL_HANDLE, 1, &pipeline_info, nullptr, &pipeline));
+    VK_CHECK(vkCreateComputePipelines(device, cache, 1, &pipeline_info, nullptr, &pipeline));
 
     return pipeline;
 }
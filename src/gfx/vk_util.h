@@ -34,13 +34,15 @@ inline auto CommandPoolCreateInfo(uint32_t queue_family_index, VkCommandPoolCrea
     };
 }
 
-inline auto CommandBufferAllocateInfo(VkCommandPool pool, uint32_t count = 1) {
+inline auto CommandBufferAllocateInfo(VkCommandPool pool,
+                                      uint32_t count = 1,
+                                      VkCommandBufferLevel level = VK_COMMAND_BUFFER_LEVEL_PRIMARY) {
     return VkCommandBufferAllocateInfo{
         .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
         .pNext = NULL,
         .commandPool = pool,
         .commandBufferCount = count,
-        .level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+        .level = level,
     };
 }
 
@@ -63,14 +65,16 @@ inline auto ImageSubresourceRange(VkImageAspectFlags aspect_mask) {
     };
 }
 
-inline auto SemaphoreSubmitInfo(VkPipelineStageFlags2 stage_mask, VkSemaphore semaphore) {
+inline auto SemaphoreSubmitInfo(VkPipelineStageFlags2 stage_mask,
+                                VkSemaphore semaphore,
+                                uint64_t value = 1) {
     return VkSemaphoreSubmitInfo{
         .sType = VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO,
         .pNext = NULL,
         .semaphore = semaphore,
         .stageMask = stage_mask,
         .deviceIndex = 0,
-        .value = 1,
+        .value = value,
     };
 }
 
@@ -281,7 +285,7 @@ class GraphicsPipelineBuilder {
 public:
     GraphicsPipelineBuilder(VkPipelineLayout layout);
     GraphicsPipelineBuilder();
-    VkPipeline Build(VkDevice device);
+    VkPipeline Build(VkDevice device, VkPipelineCache cache = VK_NULL_HANDLE);
     void Clear();
 
     GraphicsPipelineBuilder& SetShaders(VkShaderModule vertex_shader, VkShaderModule frag_shader);
@@ -326,7 +330,9 @@ private:
 VkPipeline BuildComputePipeline(VkDevice device,
                                 VkPipelineLayout layout,
                                 VkShaderModule shader,
-                                const char* entry_point = "main");
+                                const char* entry_point = "main",
+                                const VkSpecializationInfo* specialization = nullptr,
+                                VkPipelineCache cache = VK_NULL_HANDLE);
 
 VkDeviceAddress GetBufferAddress(VkDevice device, const gfx::Buffer& buffer);
 
@@ -0,0 +1,85 @@
+#include "benchmark.h"
+
+#include <SDL3/SDL_timer.h>
+
+#include <algorithm>
+
+#include "simulation.h"
+
+namespace vfs {
+
+void Benchmark::Init(const Config& input_config) {
+    config = input_config;
+}
+
+bool Benchmark::Update(u32 frame_steps) {
+    if (!Enabled())
+        return false;
+
+    auto& sim = Simulation::Get();
+    auto* model = sim.GetScene() ? sim.GetScene()->GetModel() : nullptr;
+
+    if (start_ns == 0) {
+        start_ns = SDL_GetTicksNS();
+        if (model)
+            model->SetKernelTiming(!config.timings_path.empty());
+    }
+
+    frames++;
+    steps += frame_steps;
+
+    if (model) {
+        for (const auto& [name, stats] : model->LastSolverStats()) {
+            auto it = std::find_if(solvers.begin(), solvers.end(),
+                                   [&](const SolverTotals& s) { return s.name == name; });
+            if (it == solvers.end())
+                it = solvers.insert(solvers.end(), SolverTotals{.name = name});
+
+            // Nothing was read back yet
+            if (stats.iterations == 0)
+                continue;
+
+            it->iterations += stats.iterations;
+            it->max_iterations = std::max(it->max_iterations, stats.iterations);
+            it->samples++;
+        }
+    }
+
+    if (sim.GetTime() < config.duration)
+        return false;
+
+    Report(SDL_GetTicksNS());
+    return true;
+}
+
+void Benchmark::Report(u64 end_ns) const {
+    auto& sim = Simulation::Get();
+    auto* model = sim.GetScene() ? sim.GetScene()->GetModel() : nullptr;
+
+    // The GPU is at most a few frames behind, which is negligible over a long run
+    const auto wall_time = (float)(end_ns - start_ns) * 1e-9f;
+    const auto sim_time = sim.GetTime();
+
+    fmt::println("Benchmark: {:.3f} s simulated in {} steps over {} frames", sim_time, steps,
+                 frames);
+    fmt::println("  {:.3f} s wall time, {:.3f} s per simulated second, {:.1f} steps/s", wall_time,
+                 wall_time / sim_time, (float)steps / wall_time);
+
+    if (!model)
+        return;
+
+    fmt::println("  Last substep dt: {:.3e} s",
+                 model->StepTime() / (float)model->GetParameters().iterations);
+
+    for (const auto& solver : solvers) {
+        const auto average = solver.samples > 0 ? (float)solver.iterations / solver.samples : 0.0f;
+        fmt::println("  {} solver: {:.2f} iterations on average, {} at most", solver.name, average,
+                     solver.max_iterations);
+    }
+
+    // Reports where the file went on its own
+    if (!config.timings_path.empty())
+        model->GetKernelTimer().ExportCSV(config.timings_path);
+}
+
+}  // namespace vfs
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "gfx/common.h"
+
+namespace vfs {
+
+// Runs the loaded scene for a fixed span of simulated time and prints the wall time it took, the
+// last substep dt and the iterations of the solvers, so that settings of a scene can be compared
+// from the command line. The application quits once the run is over.
+class Benchmark {
+public:
+    struct Config {
+        // Simulated seconds, no benchmark when zero
+        float duration{0.0f};
+        // Kernel timings are exported here when not empty. Timing serializes the first step of
+        // every frame, so the wall time is only comparable between runs that both time or not.
+        std::string timings_path{};
+    };
+
+    void Init(const Config& config);
+    bool Enabled() const { return config.duration > 0.0f; }
+    // Called once per frame after its steps were recorded. Returns true once the run is over.
+    bool Update(u32 steps);
+
+private:
+    // Solver stats are read back without waiting, so they are sampled once per frame
+    struct SolverTotals {
+        std::string name;
+        u64 iterations;
+        u32 max_iterations;
+        u32 samples;
+    };
+
+    Config config;
+    u64 start_ns{0};
+    u32 frames{0};
+    u64 steps{0};
+    std::vector<SolverTotals> solvers;
+
+    void Report(u64 end_ns) const;
+};
+
+}  // namespace vfs
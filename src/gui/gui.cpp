@@ -5,10 +5,12 @@
 #include <glm/ext/matrix_transform.hpp>
 #include <glm/ext/quaternion_transform.hpp>
 #include <glm/trigonometric.hpp>
+#include <vulkan/vk_enum_string_helper.h>
 
 #include "SDL3/SDL_events.h"
 #include "SDL3/SDL_keycode.h"
 #include "SDL3/SDL_mouse.h"
+#include "SDL3/SDL_timer.h"
 #include "gfx/common.h"
 #include "imgui.h"
 #include "platform.h"
@@ -23,11 +25,17 @@ struct PushConstants3D {
     VkDeviceAddress velocities;
 };
 
-void GUI::Init(Platform& platform, const std::string& input_file) {
+void GUI::Init(Platform& platform,
+               const std::string& input_file,
+               bool async_compute,
+               const Benchmark::Config& benchmark_config) {
+    const auto start_ns = SDL_GetTicksNS();
+
     gfx.Init({
         .name = "Vulkan fluid sim 3D",
         .window = platform.GetWindow(),
         .validation_layers = true,
+        .async_compute = async_compute,
     });
 
     auto& sim = Simulation::Get();
@@ -40,6 +48,9 @@ void GUI::Init(Platform& platform, const std::string& input_file) {
 
     ui.Init(gfx);
 
+    present_modes = gfx.SupportedPresentModes();
+    requested_present_mode = gfx.GetSwapchain().GetPresentMode();
+
     auto screen_size = Platform::Info::GetScreenSize();
     camera.SetPerspective(glm::radians(75.0f), 0.1f, 1000.0f, (float)screen_size.x / screen_size.y);
     camera.SetInverseDepth(false);
@@ -47,6 +58,20 @@ void GUI::Init(Platform& platform, const std::string& input_file) {
     camera.SetRadius(25.0f);
     camera.SetAngles({0.0f, -90.0f, 0.0f});
     last_camera_angles = camera.GetAngles();
+
+    // Runs unattended, as fast as the GPU allows
+    benchmark.Init(benchmark_config);
+    if (benchmark.Enabled()) {
+        paused = false;
+        scheduler.SetConfig({.mode = StepScheduler::Mode::MaxThroughput});
+    }
+
+    // Saved right away so that a crash later on still leaves a warm cache for the next start
+    gfx.SavePipelineCache();
+
+    fmt::println("Startup took {:.0f} ms with a {} pipeline cache",
+                 (float)(SDL_GetTicksNS() - start_ns) * 1e-6f,
+                 gfx.GetPipelineCache().Warm() ? "warm" : "cold");
 }
 
 void GUI::SetCameraPosition() {
@@ -64,16 +89,34 @@ void GUI::SetCameraPosition() {
 void GUI::Update(Platform& platform) {
     SetCameraPosition();
 
-    auto cmd = gfx.BeginFrame();
+    if (requested_present_mode != gfx.GetSwapchain().GetPresentMode()) {
+        gfx.SetPresentMode(requested_present_mode);
+        requested_present_mode = gfx.GetSwapchain().GetPresentMode();
+    }
+
     auto& sim = Simulation::Get();
+    const auto steps = scheduler.BeginFrame(sim.StepTime(), paused);
+
+    // The simulation of this frame overlaps the rendering of the previous one
+    if (gfx.UsesAsyncCompute()) {
+        auto compute_cmd = gfx.BeginCompute();
+        sim.Step(compute_cmd, steps);
+        gfx.SubmitCompute(compute_cmd);
+    }
 
-    if (!paused) {
-        sim.Step(cmd);
+    auto cmd = gfx.BeginFrame();
+
+    if (!gfx.UsesAsyncCompute()) {
+        sim.Step(cmd, steps);
     }
+
     renderer.Draw(gfx, cmd, camera);
     DrawUI(cmd);
 
     gfx.EndFrame(cmd, renderer.GetDrawImage());
+
+    if (benchmark.Update(steps))
+        platform.ScheduleQuit();
 }
 
 void GUI::DrawUI(VkCommandBuffer cmd) {
@@ -101,6 +144,7 @@ void GUI::DrawUI(VkCommandBuffer cmd) {
 
         if (ImGui::Button("Reset")) {
             sim.GetScene()->Reset();
+            sim.ResetTime();
             paused = true;
         }
 
@@ -127,6 +171,7 @@ void GUI::DrawUI(VkCommandBuffer cmd) {
             }
         }
 
+        DrawSteppingUI();
         Simulation::Get().DrawDebugUI();
     }
 
@@ -135,6 +180,29 @@ void GUI::DrawUI(VkCommandBuffer cmd) {
     ui.EndDraw(cmd);
 }
 
+void GUI::DrawSteppingUI() {
+    if (!ImGui::CollapsingHeader("Stepping"))
+        return;
+
+    auto& sim = Simulation::Get();
+    ImGui::Text("Simulated time: %.3f s (%u steps)", sim.GetTime(), sim.GetStepCount());
+    ImGui::Text("Simulation queue: %s",
+                !gfx.UsesAsyncCompute() ? "frame command buffer"
+                : gfx.HasComputeQueue() ? "async compute"
+                                        : "graphics (separate submit)");
+
+    scheduler.DrawDebugUI();
+
+    // Immediate and mailbox do not wait for the vertical blank, so frames are not capped by it
+    if (ImGui::BeginCombo("Present mode", string_VkPresentModeKHR(requested_present_mode))) {
+        for (auto mode : present_modes) {
+            if (ImGui::Selectable(string_VkPresentModeKHR(mode), mode == requested_present_mode))
+                requested_present_mode = mode;
+        }
+        ImGui::EndCombo();
+    }
+}
+
 void GUI::HandleEvent(Platform& platform, const Event& e) {
     ui.HandleEvent(e);
 
@@ -2,19 +2,24 @@
 
 #include <glm/ext/scalar_constants.hpp>
 
+#include "benchmark.h"
 #include "gfx/gfx.h"
 #include "gui/imgui_setup.h"
 #include "gui/scene_renderer.h"
 #include "imgui_setup.h"
 #include "platform.h"
 #include "scene_renderer.h"
+#include "step_scheduler.h"
 
 namespace vfs {
 class GUI {
 public:
     using Event = SDL_Event;
 
-    void Init(Platform& platform, const std::string& input_file);
+    void Init(Platform& platform,
+              const std::string& input_file,
+              bool async_compute = true,
+              const Benchmark::Config& benchmark_config = {});
     void Update(Platform& platform);
     void HandleEvent(Platform& platform, const Event& e);
     void Clear();
@@ -34,7 +39,13 @@ private:
     int current_frame = 0;
     bool paused{true};
 
+    StepScheduler scheduler;
+    Benchmark benchmark;
+    std::vector<VkPresentModeKHR> present_modes;
+    VkPresentModeKHR requested_present_mode;
+
     void SetCameraPosition();
     void DrawUI(VkCommandBuffer cmd);
+    void DrawSteppingUI();
 };
 }  // namespace vfs
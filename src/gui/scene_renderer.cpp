@@ -15,9 +15,6 @@ void SceneRenderer::Init(const gfx::Device& gfx, SceneBase* scene, int w, int h)
 
     clear_color = {0.0f, 0.0f, 0.0f, 1.0f};
 
-    if (scene->GetModel())
-        render_buffers = scene->GetModel()->CreateDataBuffers(gfx.GetCoreCtx());
-
     box_pipeline.Init(gfx.GetCoreCtx(), draw_img.format, depth_img.format, true);
     particles_pipeline.Init(gfx.GetCoreCtx(), draw_img.format, depth_img.format);
 
@@ -49,10 +46,6 @@ void SceneRenderer::Draw(gfx::Device& gfx, VkCommandBuffer cmd, const gfx::Camer
     auto render_info =
         vk::util::RenderingInfo(gfx.GetSwapchainExtent(), &color_attachment, &depth_attachment);
 
-    if (scene && scene->GetModel()) {
-        ComputeToComputePipelineBarrier(cmd);
-        scene->GetModel()->CopyDataBuffers(cmd, render_buffers);
-    }
     ComputeToGraphicsPipelineBarrier(cmd);
 
     vkCmdBeginRendering(cmd, &render_info);
@@ -95,8 +88,9 @@ void SceneRenderer::Draw(gfx::Device& gfx, VkCommandBuffer cmd, const gfx::Camer
             box_pipeline.Draw(cmd, gfx, draw_img, pc);
         }
 
-        auto pos_buffer = render_buffers.position_buffer.device_addr;
-        auto vel_buffer = render_buffers.velocity_buffer.device_addr;
+        const auto& render_state = scene->GetModel()->GetRenderState();
+        auto pos_buffer = render_state.position_buffer.device_addr;
+        auto vel_buffer = render_state.velocity_buffer.device_addr;
 
         auto pc_particles = Particle3DDrawPipeline::PushConstants{
             .model_view = camera.GetView() * sim_transform.Matrix(),
@@ -118,9 +112,6 @@ void SceneRenderer::Clear(const gfx::Device& gfx) {
     depth_img.Destroy();
     particles_pipeline.Clear(gfx.GetCoreCtx());
     box_pipeline.Clear(gfx.GetCoreCtx());
-    render_buffers.position_buffer.Destroy();
-    render_buffers.velocity_buffer.Destroy();
-    render_buffers.density_buffer.Destroy();
 }
 
 }  // namespace vfs
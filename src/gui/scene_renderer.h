@@ -20,8 +20,6 @@ public:
 private:
     SceneBase* scene{nullptr};
 
-    SPHModel::DataBuffers render_buffers;
-
     gfx::Transform box_transform;
     gfx::Transform sim_transform;
     gfx::GPUMesh particle_mesh;
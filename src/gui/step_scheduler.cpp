@@ -0,0 +1,116 @@
+#include "step_scheduler.h"
+
+#include <SDL3/SDL_timer.h>
+
+#include <algorithm>
+#include <cmath>
+
+#include "imgui.h"
+
+namespace vfs {
+
+namespace {
+constexpr u64 RATE_WINDOW_NS = 500'000'000;
+}
+
+u32 StepScheduler::BeginFrame(float step_time, bool paused) {
+    const auto now_ns = SDL_GetTicksNS();
+    const auto frame_time = last_frame_ns > 0 ? (float)(now_ns - last_frame_ns) * 1e-9f : 0.0f;
+    last_frame_ns = now_ns;
+    last_step_time = step_time;
+
+    const auto max_steps = (u32)std::max(config.max_steps_per_frame, 1);
+    u32 steps = 0;
+
+    if (paused) {
+        accumulator = 0.0f;
+    } else {
+        switch (config.mode) {
+        case Mode::StepsPerFrame:
+            steps = (u32)std::max(config.steps_per_frame, 1);
+            break;
+
+        case Mode::RealTime:
+            if (step_time > 0.0f) {
+                accumulator += frame_time;
+                steps = (u32)(accumulator / step_time);
+
+                // Drops the time that cannot be caught up with instead of falling further behind
+                if (steps > max_steps) {
+                    steps = max_steps;
+                    accumulator = 0.0f;
+                } else {
+                    accumulator -= steps * step_time;
+                }
+            }
+            break;
+
+        case Mode::MaxThroughput:
+            // Frames are throttled by the frame fences, so the frame time follows the GPU time of
+            // the batches in flight. The correction is damped because it lags a few frames behind.
+            if (last_steps > 0 && frame_time > 0.0f) {
+                const auto ratio = config.target_frame_time / frame_time;
+                batch *= std::clamp(ratio, 0.8f, 1.25f);
+            }
+
+            batch = std::clamp(batch, 1.0f, (float)max_steps);
+            steps = (u32)std::lround(batch);
+            break;
+        }
+    }
+
+    steps = std::min(steps, max_steps);
+    last_steps = steps;
+
+    window_steps += steps;
+    window_frames++;
+    UpdateRates(now_ns);
+
+    return steps;
+}
+
+void StepScheduler::UpdateRates(u64 now_ns) {
+    if (window_start_ns == 0)
+        window_start_ns = now_ns;
+
+    const auto elapsed = now_ns - window_start_ns;
+    if (elapsed < RATE_WINDOW_NS)
+        return;
+
+    const auto seconds = (float)elapsed * 1e-9f;
+    steps_per_second = (float)window_steps / seconds;
+    frames_per_second = (float)window_frames / seconds;
+
+    window_start_ns = now_ns;
+    window_steps = 0;
+    window_frames = 0;
+}
+
+void StepScheduler::DrawDebugUI() {
+    const char* modes[] = {"Steps per frame", "Real time", "Max throughput"};
+    auto mode = (int)config.mode;
+
+    if (ImGui::Combo("Stepping", &mode, modes, IM_ARRAYSIZE(modes))) {
+        config.mode = (Mode)mode;
+        accumulator = 0.0f;
+        batch = (float)config.steps_per_frame;
+    }
+
+    if (config.mode == Mode::StepsPerFrame)
+        ImGui::DragInt("Steps per frame", &config.steps_per_frame, 0.1f, 1,
+                       config.max_steps_per_frame);
+
+    if (config.mode == Mode::MaxThroughput) {
+        auto target_ms = config.target_frame_time * 1000.0f;
+        if (ImGui::DragFloat("Target frame time (ms)", &target_ms, 0.5f, 5.0f, 500.0f))
+            config.target_frame_time = target_ms / 1000.0f;
+    }
+
+    ImGui::DragInt("Max steps per frame", &config.max_steps_per_frame, 1.0f, 1, 4096);
+
+    ImGui::Text("%.0f steps/s, %.1f frames/s, %u steps/frame", steps_per_second, frames_per_second,
+                last_steps);
+    ImGui::Text("Simulated time rate: %.2fx", steps_per_second * last_step_time);
+}
+
+}  // namespace vfs
@@ -0,0 +1,58 @@
+#pragma once
+
+#include "gfx/common.h"
+
+namespace vfs {
+
+// Decides how many simulation steps are recorded in each rendered frame, so that the simulation
+// rate is not tied to the rate at which frames are presented.
+class StepScheduler {
+public:
+    enum class Mode : int {
+        // Fixed number of steps per rendered frame
+        StepsPerFrame = 0,
+        // As many steps as needed for the simulated time to follow the wall clock
+        RealTime,
+        // Grows the number of steps per frame until a frame takes the target frame time, so the
+        // GPU spends almost all of it simulating and only every k-th step is rendered
+        MaxThroughput,
+    };
+
+    struct Config {
+        Mode mode{Mode::StepsPerFrame};
+        int steps_per_frame{1};
+        // Upper bound in every mode. Keeps the UI responsive and frames far from the fence timeout.
+        int max_steps_per_frame{256};
+        float target_frame_time{1.0f / 30.0f};
+    };
+
+    // Number of steps to record in the current frame. `step_time` is the simulated time advanced by
+    // one step.
+    u32 BeginFrame(float step_time, bool paused);
+    void DrawDebugUI();
+
+    const Config& GetConfig() const { return config; }
+    void SetConfig(const Config& c) { config = c; }
+    float StepsPerSecond() const { return steps_per_second; }
+    float FramesPerSecond() const { return frames_per_second; }
+
+private:
+    Config config;
+
+    u64 last_frame_ns{0};
+    float accumulator{0.0f};
+    float batch{1.0f};
+    float last_step_time{0.0f};
+    u32 last_steps{0};
+
+    // Rates are averaged over windows of half a second
+    u64 window_start_ns{0};
+    u32 window_steps{0};
+    u32 window_frames{0};
+    float steps_per_second{0.0f};
+    float frames_per_second{0.0f};
+
+    void UpdateRates(u64 now_ns);
+};
+
+}  // namespace vfs
@@ -27,7 +27,26 @@ int main(int argc, char* argv[]) {
         .default_value(resources)
         .store_into(resources);
 
+    auto sync_compute = false;
+    arg_parser.add_argument("--sync-compute")
+        .help("record the simulation in the frame command buffer instead of submitting it apart")
+        .flag()
+        .store_into(sync_compute);
+
+    auto benchmark = Benchmark::Config{};
+    auto benchmark_duration = 0.0;
+    arg_parser.add_argument("--benchmark")
+        .help("simulate this many seconds as fast as possible, print the timings and quit")
+        .nargs(1)
+        .store_into(benchmark_duration);
+
+    arg_parser.add_argument("--kernel-timings")
+        .help("CSV file the kernel timings of a benchmark are written to, timing slows it down")
+        .nargs(1)
+        .store_into(benchmark.timings_path);
+
     arg_parser.parse_args(argc, argv);
+    benchmark.duration = (float)benchmark_duration;
 
     auto platform = vfs::Platform{};
     auto app = vfs::GUI{};
@@ -35,7 +54,9 @@ int main(int argc, char* argv[]) {
     platform.Init({
         .name = "VkFluidSim",
         .size = {1200, 700},
-        .init = [&app, input_file](auto& p) { app.Init(p, input_file); },
+        .init = [&app, input_file, sync_compute, benchmark](auto& p) {
+            app.Init(p, input_file, !sync_compute, benchmark);
+        },
         .update = [&app](auto& p) { app.Update(p); },
         .clean = [&app](auto& p) { app.Clear(); },
         .handler = [&app](auto& p, auto& e) { app.HandleEvent(p, e); },
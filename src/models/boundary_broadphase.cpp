@@ -0,0 +1,64 @@
+#include "boundary_broadphase.h"
+
+namespace vfs {
+
+namespace {
+// Fixed in the shader
+constexpr u32 BROADPHASE_GROUP_SIZE = 256;
+
+struct BroadphasePushConstants {
+    VkDeviceAddress candidates;
+    VkDeviceAddress objects;
+    u32 n_objects;
+    float margin;
+};
+}  // namespace
+
+void BoundaryBroadphase::Init(const gfx::Device& gfx,
+                              const gfx::BoundingBox& box,
+                              const Config& config) {
+    const auto& ctx = gfx.GetCoreCtx();
+
+    const auto resolution = glm::max(glm::uvec3(glm::ceil(box.size / config.cell_size)), 1u);
+    n_cells = resolution.x * resolution.y * resolution.z;
+
+    counts = gfx::CreateDataBuffer<u32>(ctx, n_cells);
+    objects = gfx::CreateDataBuffer<u32>(ctx, n_cells * config.max_per_cell);
+    candidates = gfx::CreateDataBuffer<BoundaryCandidates>(ctx, 1);
+
+    gfx.SetDataVal(candidates, BoundaryCandidates{
+                                   .box = box,
+                                   .resolution = resolution,
+                                   .cell_size = config.cell_size,
+                                   .max_per_cell = config.max_per_cell,
+                                   .counts = counts.device_addr,
+                                   .objects = objects.device_addr,
+                               });
+
+    pipeline.Init(ctx, {.shader_path = "shaders/compiled/boundary_broadphase.slang.spv",
+                        .kernels = {"BuildCandidates"},
+                        .push_const_size = sizeof(BroadphasePushConstants)});
+}
+
+void BoundaryBroadphase::Clear(const gfx::CoreCtx& ctx) {
+    candidates.Destroy();
+    counts.Destroy();
+    objects.Destroy();
+    pipeline.Clear(ctx);
+}
+
+void BoundaryBroadphase::Build(ComputeGraph& graph,
+                               const gfx::Buffer& boundary_objects,
+                               float margin) {
+    auto pc = BroadphasePushConstants{
+        .candidates = candidates.device_addr,
+        .objects = boundary_objects.device_addr,
+        .n_objects = (u32)(boundary_objects.size / sizeof(BoundaryObjectInfo)),
+        .margin = margin,
+    };
+
+    graph.Dispatch(pipeline, 0, glm::ivec3(n_cells / BROADPHASE_GROUP_SIZE + 1, 1, 1), &pc,
+                   {candidates, boundary_objects}, {counts, objects});
+}
+
+}  // namespace vfs
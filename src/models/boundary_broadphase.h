@@ -0,0 +1,40 @@
+#pragma once
+
+#include "compute/compute_graph.h"
+#include "compute/compute_pipeline.h"
+#include "gfx/gfx.h"
+#include "models/volume_map_boundary.h"
+
+namespace vfs {
+
+// Uniform grid over the domain with the boundary objects that can be within the smoothing radius
+// of each cell, so that a particle only samples the objects of its cell instead of all of them.
+// The grid is built on the GPU, and has to be built again whenever the objects move.
+class BoundaryBroadphase {
+public:
+    struct Config {
+        // Edge of the cells
+        float cell_size;
+        // Candidates stored per cell, the particles in cells with more test every object
+        u32 max_per_cell{8};
+    };
+
+    void Init(const gfx::Device& gfx, const gfx::BoundingBox& box, const Config& config);
+    void Clear(const gfx::CoreCtx& ctx);
+
+    // `margin` is the distance at which an object still affects a particle
+    void Build(ComputeGraph& graph, const gfx::Buffer& boundary_objects, float margin);
+
+    // BoundaryCandidates read by the models
+    VkDeviceAddress CandidatesAddr() const { return candidates.device_addr; }
+
+private:
+    u32 n_cells{0};
+    ComputePipeline pipeline;
+
+    gfx::Buffer candidates;
+    gfx::Buffer counts;
+    gfx::Buffer objects;
+};
+
+}  // namespace vfs
@@ -0,0 +1,214 @@
+#include "dfsph_model.h"
+
+#include "imgui.h"
+#include "simulation.h"
+
+namespace vfs {
+
+namespace {
+enum SimKernel : u32 {
+    KernelUpdatePositions = 0,
+    KernelBuildNeighborList,
+    KernelComputeDensityFactor,
+    KernelDivergenceSource,
+    KernelDivergenceVelocityUpdate,
+    KernelNonPressureAccel,
+    KernelPredictVelocity,
+    KernelDensitySource,
+    KernelDensityVelocityUpdate,
+};
+
+enum SolverSlot : u32 {
+    SlotDivergence = 0,
+    SlotDensity,
+};
+
+struct SolverBuffers {
+    VkDeviceAddress boundary_gradient;
+    VkDeviceAddress factors;
+    VkDeviceAddress kappa;
+    VkDeviceAddress divergence_solver;
+    VkDeviceAddress density_solver;
+};
+}  // namespace
+
+DFSPHModel::DFSPHModel(const SPHModel::Parameters* base_par,
+                       const Parameters* par,
+                       const SolverConfig* solver)
+    : SPHModel(base_par) {
+    if (par) {
+        parameters = *par;
+    } else {
+        parameters = {
+            .viscosity_strenght = 0.01,
+        };
+    }
+
+    if (solver)
+        solver_config = *solver;
+}
+
+void DFSPHModel::Init(const gfx::CoreCtx& ctx) {
+    SPHModel::Init(ctx);
+
+    const auto n = (u32)SPHModel::parameters.n_particles;
+    boundary_gradient = CreateDataBuffer<glm::vec3>(ctx, n);
+    factors = CreateDataBuffer<float>(ctx, n);
+    kappa = CreateDataBuffer<float>(ctx, n);
+    solver_loop.Init(ctx, n, 2);
+
+    InitBufferReorder(ctx);
+
+    auto& sim = Simulation::Get();
+    parameter_id = sim.AddUniformDescriptor(ctx, sizeof(Parameters));
+    solver_buf_id = sim.AddUniformDescriptor(ctx, sizeof(SolverBuffers));
+    AddBoundaryGridDescriptor();
+
+    sim.InitDescriptorManager(ctx);
+
+    sim.GetDescManager().SetUniformData(parameter_id, &parameters);
+
+    auto solver_bufs = SolverBuffers{
+        .boundary_gradient = boundary_gradient.device_addr,
+        .factors = factors.device_addr,
+        .kappa = kappa.device_addr,
+        .divergence_solver = solver_loop.StateAddr(SlotDivergence),
+        .density_solver = solver_loop.StateAddr(SlotDensity),
+    };
+
+    sim.GetDescManager().SetUniformData(solver_buf_id, &solver_bufs);
+
+    pipeline.Init(ctx, {
+                           .push_const_size = sizeof(SPHModel::PushConstants),
+                           .set = sim.GetDescManager().Set(),
+                           .layout = sim.GetDescManager().Layout(),
+                           .shader_path = "shaders/compiled/dfsph_model.slang.spv",
+                           .kernels =
+                               {
+                                   "UpdatePositions",
+                                   "BuildNeighborList",
+                                   "ComputeDensityFactor",
+                                   "DivergenceSource",
+                                   "DivergenceVelocityUpdate",
+                                   "NonPressureAccel",
+                                   "PredictVelocity",
+                                   "DensitySource",
+                                   "DensityVelocityUpdate",
+                               },
+                           .constants = SpecializationConstants(),
+                       });
+
+    InitNeighborList(ctx, KernelBuildNeighborList);
+    UpdateAllUniforms();
+}
+
+void DFSPHModel::RecordStep(const gfx::CoreCtx& ctx, ComputeGraph& graph) {
+    auto push = StepPushConstants();
+
+    auto n_groups = glm::ivec3(SPHModel::parameters.n_particles / group_size + 1, 1, 1);
+
+    const auto& b = buffers;
+    const auto divergence_state = solver_loop.StateRange(SlotDivergence);
+    const auto density_state = solver_loop.StateRange(SlotDensity);
+
+    for (int i = 0; i < SPHModel::parameters.iterations; i++) {
+        RunSpatialHash(graph, ctx);
+
+        graph.Dispatch(pipeline, KernelComputeDensityFactor, n_groups, &push,
+                       NeighborReads({b.position_buffer}),
+                       {b.density_buffer, factors, boundary_gradient});
+
+        if (solver_config.divergence_solve) {
+            graph.BeginScope("Divergence solve");
+            solver_loop.Run(graph, SlotDivergence, solver_config.divergence, [&](ComputeGraph& g) {
+                g.Dispatch(pipeline, KernelDivergenceSource, n_groups, &push,
+                           NeighborReads({b.position_buffer, b.velocity_buffer, factors,
+                                          boundary_gradient}),
+                           {kappa, divergence_state});
+                g.Dispatch(pipeline, KernelDivergenceVelocityUpdate, n_groups, &push,
+                           NeighborReads({b.position_buffer, kappa, boundary_gradient,
+                                          divergence_state}),
+                           {b.velocity_buffer});
+            });
+            graph.EndScope();
+        }
+
+        graph.Dispatch(pipeline, KernelNonPressureAccel, n_groups, &push,
+                       NeighborReads({b.position_buffer, b.velocity_buffer, b.density_buffer}),
+                       {b.accel_buffer});
+
+        graph.Dispatch(pipeline, KernelPredictVelocity, n_groups, &push, {b.accel_buffer},
+                       {b.velocity_buffer});
+
+        graph.BeginScope("Density solve");
+        solver_loop.Run(graph, SlotDensity, solver_config.density, [&](ComputeGraph& g) {
+            g.Dispatch(pipeline, KernelDensitySource, n_groups, &push,
+                       NeighborReads({b.position_buffer, b.velocity_buffer, b.density_buffer,
+                                      factors, boundary_gradient}),
+                       {kappa, density_state});
+            g.Dispatch(
+                pipeline, KernelDensityVelocityUpdate, n_groups, &push,
+                NeighborReads({b.position_buffer, kappa, boundary_gradient, density_state}),
+                {b.velocity_buffer});
+        });
+        graph.EndScope();
+
+        DispatchUpdate(graph, KernelUpdatePositions, i, {b.accel_buffer},
+                       {b.position_buffer, b.velocity_buffer});
+    }
+}
+
+std::vector<ComputePipeline::SpecializationConstant> DFSPHModel::SpecializationConstants() const {
+    auto constants = SPHModel::SpecializationConstants();
+
+    // Fixed by the scene, so the boundary handling is compiled out when there are no objects
+    if (specialize_parameters)
+        constants.push_back({.id = 2, .value = parameters.n_boundary_objects});
+
+    return constants;
+}
+
+void DFSPHModel::Clear(const gfx::CoreCtx& ctx) {
+    SPHModel::Clear(ctx);
+
+    boundary_gradient.Destroy();
+    factors.Destroy();
+    kappa.Destroy();
+    solver_loop.Clear(ctx);
+}
+
+std::vector<SPHModel::SolverStats> DFSPHModel::LastSolverStats() const {
+    auto stats = std::vector<SolverStats>{{"Density", solver_loop.LastStats(SlotDensity)}};
+    if (solver_config.divergence_solve)
+        stats.push_back({"Divergence", solver_loop.LastStats(SlotDivergence)});
+
+    return stats;
+}
+
+void DFSPHModel::DrawDebugUI() {
+    SPHModel::DrawDebugUI();
+
+    auto& sim = Simulation::Get();
+
+    if (ImGui::CollapsingHeader("DFSPH model")) {
+        if (ImGui::DragFloat("Viscosity", &parameters.viscosity_strenght, 0.001f, 0.0f, 1.0f)) {
+            sim.GetDescManager().SetUniformData(parameter_id, &parameters);
+        }
+
+        auto changed = false;
+
+        ImGui::SeparatorText("Density solve");
+        changed |= solver_loop.DrawUI("Density", SlotDensity, solver_config.density, 10.0f);
+
+        ImGui::SeparatorText("Divergence solve");
+        changed |= ImGui::Checkbox("Enabled", &solver_config.divergence_solve);
+        if (solver_config.divergence_solve) {
+            changed |= solver_loop.DrawUI("Divergence", SlotDivergence, solver_config.divergence,
+                                          100.0f);
+        }
+
+        if (changed)
+            InvalidateStepCommands();
+    }
+}
+}  // namespace vfs
@@ -0,0 +1,60 @@
+#pragma once
+
+#include "compute/solver_loop.h"
+#include "gfx/common.h"
+#include "models/model.h"
+#include "models/volume_map_boundary.h"
+
+namespace vfs {
+/*
+ * This model is based on the work by J. Bender and D. Koschier, “Divergence-free smoothed particle
+ * hydrodynamics,” in Proceedings of the 14th ACM SIGGRAPH / Eurographics Symposium on Computer
+ * Animation, in SCA ’15. Los Angeles, California: Association for Computing Machinery, 2015,
+ * pp. 147–155.
+ */
+class DFSPHModel final : public SPHModel {
+public:
+    struct Parameters {
+        float viscosity_strenght;
+        VkDeviceAddress boundary_objects{0};
+        u32 n_boundary_objects{0};
+        VkDeviceAddress boundary_candidates{0};
+    };
+
+    struct SolverConfig {
+        // Keeps the velocity field divergence-free, which allows larger time steps
+        bool divergence_solve{true};
+        // Average density error, as a fraction of the target density
+        GPUSolverLoop::Config density{
+            .tolerance = 1e-3f, .min_iterations = 2, .max_iterations = 20};
+        // Average density change over a substep
+        GPUSolverLoop::Config divergence{
+            .tolerance = 1e-2f, .min_iterations = 1, .max_iterations = 10};
+    };
+
+    DFSPHModel(const SPHModel::Parameters* sph_parameters = nullptr,
+               const Parameters* parameters = nullptr,
+               const SolverConfig* solver_config = nullptr);
+
+    void Init(const gfx::CoreCtx& ctx) override;
+    void Clear(const gfx::CoreCtx& ctx) override;
+    void DrawDebugUI() override;
+    std::vector<SolverStats> LastSolverStats() const override;
+
+protected:
+    void RecordStep(const gfx::CoreCtx& ctx, ComputeGraph& graph) override;
+    std::vector<ComputePipeline::SpecializationConstant> SpecializationConstants() const override;
+
+private:
+    u32 parameter_id{0};
+    Parameters parameters;
+    SolverConfig solver_config;
+
+    u32 solver_buf_id{0};
+    gfx::Buffer boundary_gradient;
+    gfx::Buffer factors;
+    gfx::Buffer kappa;
+    GPUSolverLoop solver_loop;
+};
+
+}  // namespace vfs
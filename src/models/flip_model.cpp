@@ -0,0 +1,225 @@
+#include "flip_model.h"
+
+#include "imgui.h"
+#include "simulation.h"
+
+namespace vfs {
+
+namespace {
+enum SimKernel : u32 {
+    KernelUpdatePositions = 0,
+    KernelClassifyCells,
+    KernelTransferToGrid,
+    KernelComputeDivergence,
+    KernelPressureProduct,
+    KernelApplyPressure,
+};
+
+struct GridBuffers {
+    glm::uvec3 resolution;
+    float cell_size;
+    VkDeviceAddress velocities;
+    VkDeviceAddress saved_velocities;
+    VkDeviceAddress cell_types;
+    VkDeviceAddress pressures;
+    VkDeviceAddress rhs;
+    VkDeviceAddress direction;
+    VkDeviceAddress product;
+    VkDeviceAddress inv_diagonal;
+    VkDeviceAddress fluid_cells;
+    VkDeviceAddress affine_x;
+    VkDeviceAddress affine_y;
+    VkDeviceAddress affine_z;
+};
+}  // namespace
+
+FLIPModel::FLIPModel(const SPHModel::Parameters* base_par,
+                     const Parameters* par,
+                     const SolverConfig* solver)
+    : SPHModel(base_par) {
+    if (par)
+        parameters = *par;
+
+    if (solver)
+        solver_config = *solver;
+}
+
+void FLIPModel::Init(const gfx::CoreCtx& ctx) {
+    SPHModel::Init(ctx);
+
+    // The grid covers the bounding box, which is fixed from here on
+    const auto box_size = SPHModel::parameters.bounding_box.size;
+    resolution = glm::max(glm::uvec3(glm::ceil(box_size / parameters.cell_size)), glm::uvec3(1));
+    n_cells = resolution.x * resolution.y * resolution.z;
+    n_faces = (resolution.x + 1) * resolution.y * resolution.z +
+              resolution.x * (resolution.y + 1) * resolution.z +
+              resolution.x * resolution.y * (resolution.z + 1);
+
+    fmt::println("FLIP grid of {}x{}x{} cells", resolution.x, resolution.y, resolution.z);
+
+    const auto n = (u32)SPHModel::parameters.n_particles;
+    face_velocities = CreateDataBuffer<float>(ctx, n_faces);
+    saved_velocities = CreateDataBuffer<float>(ctx, n_faces);
+    cell_types = CreateDataBuffer<u32>(ctx, n_cells);
+    affine_x = CreateDataBuffer<glm::vec3>(ctx, n);
+    affine_y = CreateDataBuffer<glm::vec3>(ctx, n);
+    affine_z = CreateDataBuffer<glm::vec3>(ctx, n);
+    pressure_cg.Init(ctx, n_cells, {.components = 1, .preconditioned = true, .counted = true});
+
+    AddBufferToBeReordered(affine_x);
+    AddBufferToBeReordered(affine_y);
+    AddBufferToBeReordered(affine_z);
+    InitBufferReorder(ctx);
+
+    auto& sim = Simulation::Get();
+    parameter_id = sim.AddUniformDescriptor(ctx, sizeof(Parameters));
+    grid_buf_id = sim.AddUniformDescriptor(ctx, sizeof(GridBuffers));
+    AddBoundaryGridDescriptor();
+
+    sim.InitDescriptorManager(ctx);
+
+    sim.GetDescManager().SetUniformData(parameter_id, &parameters);
+
+    auto grid_bufs = GridBuffers{
+        .resolution = resolution,
+        .cell_size = parameters.cell_size,
+        .velocities = face_velocities.device_addr,
+        .saved_velocities = saved_velocities.device_addr,
+        .cell_types = cell_types.device_addr,
+        .pressures = pressure_cg.Solution().device_addr,
+        .rhs = pressure_cg.RightHandSide().device_addr,
+        .direction = pressure_cg.Direction().device_addr,
+        .product = pressure_cg.Product().device_addr,
+        .inv_diagonal = pressure_cg.InverseDiagonal().device_addr,
+        .fluid_cells = pressure_cg.ElementCount().device_addr,
+        .affine_x = affine_x.device_addr,
+        .affine_y = affine_y.device_addr,
+        .affine_z = affine_z.device_addr,
+    };
+
+    sim.GetDescManager().SetUniformData(grid_buf_id, &grid_bufs);
+
+    pipeline.Init(ctx, {
+                           .push_const_size = sizeof(SPHModel::PushConstants),
+                           .set = sim.GetDescManager().Set(),
+                           .layout = sim.GetDescManager().Layout(),
+                           .shader_path = "shaders/compiled/flip_model.slang.spv",
+                           .kernels =
+                               {
+                                   "UpdatePositions",
+                                   "ClassifyCells",
+                                   "TransferToGrid",
+                                   "ComputeDivergence",
+                                   "PressureProduct",
+                                   "ApplyPressure",
+                               },
+                           .constants = SpecializationConstants(),
+                       });
+
+    UpdateAllUniforms();
+}
+
+void FLIPModel::SetParticleState(const gfx::Device& gfx,
+                                 const std::vector<glm::vec3>& pos,
+                                 const std::vector<glm::vec3>& vel,
+                                 u32 offset,
+                                 i64 count) {
+    SPHModel::SetParticleState(gfx, pos, vel, offset, count);
+
+    gfx.SetDataVal(affine_x, glm::vec3(0.0f), offset, count);
+    gfx.SetDataVal(affine_y, glm::vec3(0.0f), offset, count);
+    gfx.SetDataVal(affine_z, glm::vec3(0.0f), offset, count);
+    gfx.SetDataVal(pressure_cg.Solution(), 0.0f);
+}
+
+void FLIPModel::RecordStep(const gfx::CoreCtx& ctx, ComputeGraph& graph) {
+    auto push = StepPushConstants();
+
+    auto particle_groups = glm::ivec3(SPHModel::parameters.n_particles / group_size + 1, 1, 1);
+    auto cell_groups = glm::ivec3(n_cells / group_size + 1, 1, 1);
+    auto face_groups = glm::ivec3(n_faces / group_size + 1, 1, 1);
+
+    const auto& b = buffers;
+    const auto& cg = pressure_cg;
+
+    for (int i = 0; i < SPHModel::parameters.iterations; i++) {
+        // Only used to gather the particles around the cells and faces
+        RunSpatialHash(graph, ctx);
+
+        graph.BeginScope("Particles to grid");
+        graph.Dispatch(pipeline, KernelClassifyCells, cell_groups, &push,
+                       NeighborReads({b.position_buffer}), {cell_types, cg.ElementCount()});
+        graph.Dispatch(pipeline, KernelTransferToGrid, face_groups, &push,
+                       NeighborReads({b.position_buffer, b.velocity_buffer, affine_x, affine_y,
+                                      affine_z}),
+                       {face_velocities, saved_velocities});
+        graph.EndScope();
+
+        graph.BeginScope("Pressure projection");
+        graph.Dispatch(pipeline, KernelComputeDivergence, cell_groups, &push,
+                       {cell_types, face_velocities},
+                       {cg.RightHandSide(), cg.Solution(), cg.InverseDiagonal(),
+                        cg.ElementCount()});
+
+        pressure_cg.Solve(graph, solver_config, [&](ComputeGraph& g) {
+            g.Dispatch(pipeline, KernelPressureProduct, cell_groups, &push,
+                       {cell_types, cg.Direction()}, {cg.Product()});
+        });
+
+        graph.Dispatch(pipeline, KernelApplyPressure, face_groups, &push,
+                       {cell_types, cg.Solution()}, {face_velocities});
+        graph.EndScope();
+
+        DispatchUpdate(graph, KernelUpdatePositions, i,
+                       {b.position_buffer, b.velocity_buffer, face_velocities, saved_velocities},
+                       {b.position_buffer, b.velocity_buffer, b.accel_buffer, affine_x, affine_y,
+                        affine_z});
+    }
+}
+
+std::vector<ComputePipeline::SpecializationConstant> FLIPModel::SpecializationConstants() const {
+    auto constants = SPHModel::SpecializationConstants();
+
+    // Fixed by the scene, so the boundary handling is compiled out when there are no objects
+    if (specialize_parameters)
+        constants.push_back({.id = 2, .value = parameters.n_boundary_objects});
+
+    return constants;
+}
+
+void FLIPModel::Clear(const gfx::CoreCtx& ctx) {
+    SPHModel::Clear(ctx);
+
+    face_velocities.Destroy();
+    saved_velocities.Destroy();
+    cell_types.Destroy();
+    affine_x.Destroy();
+    affine_y.Destroy();
+    affine_z.Destroy();
+    pressure_cg.Clear(ctx);
+}
+
+void FLIPModel::DrawDebugUI() {
+    SPHModel::DrawDebugUI();
+
+    auto& sim = Simulation::Get();
+
+    if (ImGui::CollapsingHeader("FLIP model")) {
+        ImGui::Text("Grid: %ux%ux%u cells of %.3f", resolution.x, resolution.y, resolution.z,
+                    parameters.cell_size);
+
+        auto apic = parameters.apic != 0;
+        auto changed = ImGui::Checkbox("APIC transfers", &apic);
+        parameters.apic = apic ? 1 : 0;
+
+        if (!apic)
+            changed |= ImGui::DragFloat("FLIP ratio", &parameters.flip_ratio, 0.005f, 0.0f, 1.0f);
+
+        if (changed)
+            sim.GetDescManager().SetUniformData(parameter_id, &parameters);
+
+        if (pressure_cg.DrawUI("Pressure", solver_config, 1.0f))
+            InvalidateStepCommands();
+    }
+}
+}  // namespace vfs
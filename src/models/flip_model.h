@@ -0,0 +1,76 @@
+#pragma once
+
+#include "compute/conjugate_gradient.h"
+#include "gfx/common.h"
+#include "models/model.h"
+#include "models/volume_map_boundary.h"
+
+namespace vfs {
+/*
+ * Hybrid particle-grid model: the particles carry the velocity, which is transferred to a MAC grid
+ * over the bounding box, made divergence free there and transferred back. This model is based on
+ * the work by Y. Zhu and R. Bridson, “Animating sand as a fluid,” ACM Transactions on Graphics,
+ * vol. 24, no. 3, pp. 965–972, 2005, and on C. Jiang, C. Schroeder, A. Selle, J. Teran and
+ * A. Stomakhin, “The affine particle-in-cell method,” ACM Transactions on Graphics, vol. 34,
+ * no. 4, pp. 51:1–51:10, 2015.
+ */
+class FLIPModel final : public SPHModel {
+public:
+    struct Parameters {
+        // 0 is PIC, 1 is FLIP. Values close to 1 keep the details, lower ones damp the noise.
+        float flip_ratio{0.95f};
+        // Replaces the FLIP blend by the affine transfers when not 0
+        u32 apic{0};
+        VkDeviceAddress boundary_objects{0};
+        u32 n_boundary_objects{0};
+        VkDeviceAddress boundary_candidates{0};
+        // Edge of the grid cells, fixed at Init. About two particles per cell edge works best.
+        float cell_size{0.1f};
+    };
+
+    // Average residual of the pressure equation over the fluid cells, relative to its right-hand
+    // side. The air and solid cells are left out of the average.
+    using SolverConfig = GPUConjugateGradient::Config;
+
+    FLIPModel(const SPHModel::Parameters* sph_parameters = nullptr,
+              const Parameters* parameters = nullptr,
+              const SolverConfig* solver_config = nullptr);
+
+    void Init(const gfx::CoreCtx& ctx) override;
+    void Clear(const gfx::CoreCtx& ctx) override;
+    void DrawDebugUI() override;
+    // Also clears the affine velocities and the pressure guess
+    void SetParticleState(const gfx::Device& gfx,
+                          const std::vector<glm::vec3>& pos,
+                          const std::vector<glm::vec3>& vel,
+                          u32 offset = 0,
+                          i64 count = -1) override;
+
+    GPUSolverLoop::Stats LastSolveStats() const { return pressure_cg.LastStats(); }
+    std::vector<SolverStats> LastSolverStats() const override {
+        return {{"Pressure", LastSolveStats()}};
+    }
+
+protected:
+    void RecordStep(const gfx::CoreCtx& ctx, ComputeGraph& graph) override;
+    std::vector<ComputePipeline::SpecializationConstant> SpecializationConstants() const override;
+
+private:
+    u32 parameter_id{0};
+    Parameters parameters;
+    SolverConfig solver_config{.tolerance = 1e-2f, .min_iterations = 1, .max_iterations = 100};
+
+    u32 grid_buf_id{0};
+    glm::uvec3 resolution{0};
+    u32 n_cells{0};
+    u32 n_faces{0};
+    gfx::Buffer face_velocities;
+    gfx::Buffer saved_velocities;
+    gfx::Buffer cell_types;
+    gfx::Buffer affine_x;
+    gfx::Buffer affine_y;
+    gfx::Buffer affine_z;
+    GPUConjugateGradient pressure_cg;
+};
+
+}  // namespace vfs
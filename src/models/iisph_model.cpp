@@ -0,0 +1,192 @@
+#include "iisph_model.h"
+
+#include "imgui.h"
+#include "simulation.h"
+
+namespace vfs {
+
+namespace {
+enum SimKernel : u32 {
+    KernelUpdatePositions = 0,
+    KernelBuildNeighborList,
+    KernelComputeDensityDiagonal,
+    KernelNonPressureAccel,
+    KernelPredictVelocity,
+    KernelAdvectedDensity,
+    KernelUpdatePressureAccel,
+    KernelUpdatePressure,
+    KernelApplyPressure,
+};
+
+struct SolverBuffers {
+    VkDeviceAddress boundary_gradient;
+    VkDeviceAddress diagonal;
+    VkDeviceAddress source;
+    VkDeviceAddress pressures;
+    VkDeviceAddress pressure_accel;
+    VkDeviceAddress solver;
+};
+}  // namespace
+
+IISPHModel::IISPHModel(const SPHModel::Parameters* base_par,
+                       const Parameters* par,
+                       const SolverConfig* solver)
+    : SPHModel(base_par) {
+    if (par) {
+        parameters = *par;
+    } else {
+        parameters = {
+            .viscosity_strenght = 0.01,
+        };
+    }
+
+    if (solver)
+        solver_config = *solver;
+}
+
+void IISPHModel::Init(const gfx::CoreCtx& ctx) {
+    SPHModel::Init(ctx);
+
+    const auto n = (u32)SPHModel::parameters.n_particles;
+    boundary_gradient = CreateDataBuffer<glm::vec3>(ctx, n);
+    diagonal = CreateDataBuffer<float>(ctx, n);
+    source = CreateDataBuffer<float>(ctx, n);
+    pressures = CreateDataBuffer<float>(ctx, n);
+    pressure_accel = CreateDataBuffer<glm::vec3>(ctx, n);
+    solver_loop.Init(ctx, n);
+
+    InitBufferReorder(ctx);
+
+    auto& sim = Simulation::Get();
+    parameter_id = sim.AddUniformDescriptor(ctx, sizeof(Parameters));
+    solver_buf_id = sim.AddUniformDescriptor(ctx, sizeof(SolverBuffers));
+    AddBoundaryGridDescriptor();
+
+    sim.InitDescriptorManager(ctx);
+
+    sim.GetDescManager().SetUniformData(parameter_id, &parameters);
+
+    auto solver_bufs = SolverBuffers{
+        .boundary_gradient = boundary_gradient.device_addr,
+        .diagonal = diagonal.device_addr,
+        .source = source.device_addr,
+        .pressures = pressures.device_addr,
+        .pressure_accel = pressure_accel.device_addr,
+        .solver = solver_loop.StateAddr(0),
+    };
+
+    sim.GetDescManager().SetUniformData(solver_buf_id, &solver_bufs);
+
+    pipeline.Init(ctx, {
+                           .push_const_size = sizeof(SPHModel::PushConstants),
+                           .set = sim.GetDescManager().Set(),
+                           .layout = sim.GetDescManager().Layout(),
+                           .shader_path = "shaders/compiled/iisph_model.slang.spv",
+                           .kernels =
+                               {
+                                   "UpdatePositions",
+                                   "BuildNeighborList",
+                                   "ComputeDensityDiagonal",
+                                   "NonPressureAccel",
+                                   "PredictVelocity",
+                                   "AdvectedDensity",
+                                   "UpdatePressureAccel",
+                                   "UpdatePressure",
+                                   "ApplyPressure",
+                               },
+                           .constants = SpecializationConstants(),
+                       });
+
+    InitNeighborList(ctx, KernelBuildNeighborList);
+    UpdateAllUniforms();
+}
+
+void IISPHModel::RecordStep(const gfx::CoreCtx& ctx, ComputeGraph& graph) {
+    auto push = StepPushConstants();
+
+    auto n_groups = glm::ivec3(SPHModel::parameters.n_particles / group_size + 1, 1, 1);
+
+    const auto& b = buffers;
+    const auto state = solver_loop.StateRange(0);
+
+    for (int i = 0; i < SPHModel::parameters.iterations; i++) {
+        RunSpatialHash(graph, ctx);
+
+        graph.Dispatch(pipeline, KernelComputeDensityDiagonal, n_groups, &push,
+                       NeighborReads({b.position_buffer}),
+                       {b.density_buffer, diagonal, boundary_gradient});
+
+        graph.Dispatch(pipeline, KernelNonPressureAccel, n_groups, &push,
+                       NeighborReads({b.position_buffer, b.velocity_buffer, b.density_buffer}),
+                       {b.accel_buffer});
+
+        graph.Dispatch(pipeline, KernelPredictVelocity, n_groups, &push, {b.accel_buffer},
+                       {b.velocity_buffer});
+
+        graph.Dispatch(pipeline, KernelAdvectedDensity, n_groups, &push,
+                       NeighborReads({b.position_buffer, b.velocity_buffer, b.density_buffer,
+                                      boundary_gradient}),
+                       {source, pressures});
+
+        graph.BeginScope("Pressure solve");
+        solver_loop.Run(graph, 0, solver_config, [&](ComputeGraph& g) {
+            g.Dispatch(pipeline, KernelUpdatePressureAccel, n_groups, &push,
+                       NeighborReads({b.position_buffer, b.density_buffer, pressures,
+                                      boundary_gradient, state}),
+                       {pressure_accel});
+            g.Dispatch(pipeline, KernelUpdatePressure, n_groups, &push,
+                       NeighborReads({b.position_buffer, pressure_accel, diagonal, source,
+                                      boundary_gradient}),
+                       {pressures, state});
+        });
+        graph.EndScope();
+
+        graph.Dispatch(pipeline, KernelApplyPressure, n_groups, &push,
+                       NeighborReads({b.position_buffer, b.density_buffer, pressures,
+                                      boundary_gradient}),
+                       {b.velocity_buffer, b.accel_buffer});
+
+        DispatchUpdate(graph, KernelUpdatePositions, i, {b.accel_buffer},
+                       {b.position_buffer, b.velocity_buffer});
+    }
+}
+
+std::vector<ComputePipeline::SpecializationConstant> IISPHModel::SpecializationConstants() const {
+    auto constants = SPHModel::SpecializationConstants();
+
+    // Fixed by the scene, so the boundary handling is compiled out when there are no objects
+    if (specialize_parameters)
+        constants.push_back({.id = 2, .value = parameters.n_boundary_objects});
+
+    return constants;
+}
+
+void IISPHModel::Clear(const gfx::CoreCtx& ctx) {
+    SPHModel::Clear(ctx);
+
+    boundary_gradient.Destroy();
+    diagonal.Destroy();
+    source.Destroy();
+    pressures.Destroy();
+    pressure_accel.Destroy();
+    solver_loop.Clear(ctx);
+}
+
+void IISPHModel::DrawDebugUI() {
+    SPHModel::DrawDebugUI();
+
+    auto& sim = Simulation::Get();
+
+    if (ImGui::CollapsingHeader("IISPH model")) {
+        auto changed = ImGui::DragFloat("Viscosity", &parameters.viscosity_strenght, 0.001f, 0.0f,
+                                        1.0f);
+        changed |= ImGui::DragFloat("Relaxation", &parameters.omega, 0.01f, 0.05f, 1.0f);
+        if (changed)
+            sim.GetDescManager().SetUniformData(parameter_id, &parameters);
+
+        ImGui::SeparatorText("Pressure solve");
+        if (solver_loop.DrawUI("Pressure", 0, solver_config, 10.0f))
+            InvalidateStepCommands();
+    }
+}
+}  // namespace vfs
@@ -0,0 +1,59 @@
+#pragma once
+
+#include "compute/solver_loop.h"
+#include "gfx/common.h"
+#include "models/model.h"
+#include "models/volume_map_boundary.h"
+
+namespace vfs {
+/*
+ * This model is based on the work by M. Ihmsen, J. Cornelis, B. Solenthaler, C. Horvath and
+ * M. Teschner, “Implicit Incompressible SPH,” IEEE Transactions on Visualization and Computer
+ * Graphics, vol. 20, no. 3, pp. 426–435, 2014.
+ */
+class IISPHModel final : public SPHModel {
+public:
+    struct Parameters {
+        float viscosity_strenght;
+        // Relaxation of the Jacobi updates, 0.5 in the paper
+        float omega{0.5f};
+        VkDeviceAddress boundary_objects{0};
+        u32 n_boundary_objects{0};
+        VkDeviceAddress boundary_candidates{0};
+    };
+
+    // Average density error, as a fraction of the target density
+    using SolverConfig = GPUSolverLoop::Config;
+
+    IISPHModel(const SPHModel::Parameters* sph_parameters = nullptr,
+               const Parameters* parameters = nullptr,
+               const SolverConfig* solver_config = nullptr);
+
+    void Init(const gfx::CoreCtx& ctx) override;
+    void Clear(const gfx::CoreCtx& ctx) override;
+    void DrawDebugUI() override;
+
+    GPUSolverLoop::Stats LastSolveStats() const { return solver_loop.LastStats(0); }
+    std::vector<SolverStats> LastSolverStats() const override {
+        return {{"Pressure", LastSolveStats()}};
+    }
+
+protected:
+    void RecordStep(const gfx::CoreCtx& ctx, ComputeGraph& graph) override;
+    std::vector<ComputePipeline::SpecializationConstant> SpecializationConstants() const override;
+
+private:
+    u32 parameter_id{0};
+    Parameters parameters;
+    SolverConfig solver_config{.tolerance = 1e-3f, .min_iterations = 2, .max_iterations = 50};
+
+    u32 solver_buf_id{0};
+    gfx::Buffer boundary_gradient;
+    gfx::Buffer diagonal;
+    gfx::Buffer source;
+    gfx::Buffer pressures;
+    gfx::Buffer pressure_accel;
+    GPUSolverLoop solver_loop;
+};
+
+}  // namespace vfs
@@ -14,6 +14,8 @@ enum SimKernel : u32 {
     KernelExternalForces,
     KernelCalculateDensities,
     KernelCalculatePressureForces,
+    KernelCalculateDensitiesTiled,
+    KernelCalculatePressureForcesTiled,
 };
 
 struct LagueModelBuffers {
@@ -61,8 +63,12 @@ void LagueModel::Init(const gfx::CoreCtx& ctx) {
                                    "ExternalForces",
                                    "CalculateDensities",
                                    "CalculatePressureForces",
+                                   "CalculateDensitiesTiled",
+                                   "CalculatePressureForcesTiled",
                                },
+                           .constants = SpecializationConstants(),
                        });
+    has_tiled_kernels = true;
 
     UpdateAllUniforms();
 }
@@ -84,43 +90,40 @@ void LagueModel::ScheduleUpdateUniforms() {
     update_uniforms = true;
 }
 
-void LagueModel::Step(const gfx::CoreCtx& ctx, VkCommandBuffer cmd) {
-    SPHModel::Step(ctx, cmd);
-
+void LagueModel::Step(const gfx::CoreCtx& ctx, VkCommandBuffer cmd, u32 count) {
     if (update_uniforms) {
         UpdateAllUniforms();
         update_uniforms = false;
     }
 
-    auto push = PushConstants{
-        .time = Platform::Info::GetTime(),
-        .dt = SPHModel::parameters.time_scale * SPHModel::parameters.fixed_dt /
-              (float)SPHModel::parameters.iterations,
-        .n_particles = (uint32_t)SPHModel::parameters.n_particles,
-    };
+    SPHModel::Step(ctx, cmd, count);
+}
+
+void LagueModel::RecordStep(const gfx::CoreCtx& ctx, ComputeGraph& graph) {
+    auto push = StepPushConstants();
 
     auto n_groups = glm::ivec3(SPHModel::parameters.n_particles / group_size + 1, 1, 1);
 
-    for (int i = 0; i < SPHModel::parameters.iterations; i++) {
-        if (i > 0)
-            ComputeToComputePipelineBarrier(cmd);
+    const auto& b = SPHModel::buffers;
 
-        pipeline.Compute(cmd, KernelExternalForces, n_groups, &push);
-        ComputeToComputePipelineBarrier(cmd);
+    for (int i = 0; i < SPHModel::parameters.iterations; i++) {
+        graph.Dispatch(pipeline, KernelExternalForces, n_groups, &push, {b.position_buffer},
+                       {b.velocity_buffer, predicted_positions});
 
-        RunSpatialHash(cmd, ctx, &predicted_positions);
-        ComputeToComputePipelineBarrier(cmd);
+        RunSpatialHash(graph, ctx, &predicted_positions);
 
-        pipeline.Compute(cmd, KernelCalculateDensities, n_groups, &push);
-        ComputeToComputePipelineBarrier(cmd);
+        ComputeNeighborKernel(graph, KernelCalculateDensities, KernelCalculateDensitiesTiled, &push,
+                              {predicted_positions}, {b.density_buffer, near_density});
 
-        pipeline.Compute(cmd, KernelCalculatePressureForces, n_groups, &push);
-        ComputeToComputePipelineBarrier(cmd);
+        ComputeNeighborKernel(graph, KernelCalculatePressureForces,
+                              KernelCalculatePressureForcesTiled, &push,
+                              {predicted_positions, b.density_buffer, near_density},
+                              {b.velocity_buffer});
 
         // pipeline.Compute(cmd, KernelCalculateViscosityForces, n_groups, &comp_consts);
         // ComputeToComputePipelineBarrier(cmd);
 
-        pipeline.Compute(cmd, KernelUpdatePositions, n_groups, &push);
+        DispatchUpdate(graph, KernelUpdatePositions, i, {}, {b.position_buffer, b.velocity_buffer});
     }
 }
 
@@ -25,10 +25,13 @@ public:
                const Parameters* parameters = nullptr);
 
     void Init(const gfx::CoreCtx& ctx) override;
-    void Step(const gfx::CoreCtx& ctx, VkCommandBuffer cmd) override;
+    void Step(const gfx::CoreCtx& ctx, VkCommandBuffer cmd, u32 count = 1) override;
     void Clear(const gfx::CoreCtx& ctx) override;
     void DrawDebugUI() override;
 
+protected:
+    void RecordStep(const gfx::CoreCtx& ctx, ComputeGraph& graph) override;
+
 private:
     Parameters parameters;
 
@@ -1,15 +1,30 @@
 #include "model.h"
 
+#include <algorithm>
+#include <bit>
 #include <glm/ext/scalar_constants.hpp>
 #include <random>
+#include <string>
 
 #include "gfx/common.h"
 #include "imgui.h"
+#include "platform.h"
 #include "simulation.h"
 
 namespace vfs {
 namespace {
 
+struct TimeStepPushConstants {
+    VkDeviceAddress state;
+    VkDeviceAddress readback;
+    float smooth_radius;
+    float cfl;
+    float force_factor;
+    float max_growth;
+    float min_dt;
+    float max_dt;
+};
+
 std::vector<glm::vec3> SpawnRandomParticlesInBox(const gfx::BoundingBox& box, u32 count) {
     std::random_device dev;
     std::mt19937 rng(dev());
@@ -82,8 +97,15 @@ SPHModel::SPHModel(const Parameters* par) {
 void SPHModel::Init(const gfx::CoreCtx& ctx) {
     fmt::println("Number of particles: {} ", parameters.n_particles);
 
-    spatial_hash.Init(ctx, parameters.n_particles,
-                      Simulation::Get().GetGlobalParameters().smooth_radius);
+    // The spec only guarantees 128 invocations per workgroup
+    VkPhysicalDeviceProperties props;
+    vkGetPhysicalDeviceProperties(ctx.chosen_gpu, &props);
+    max_group_size = std::min(props.limits.maxComputeWorkGroupInvocations,
+                              props.limits.maxComputeWorkGroupSize[0]);
+    group_size = std::min(group_size, max_group_size);
+
+    smooth_radius = Simulation::Get().GetGlobalParameters().smooth_radius;
+    spatial_hash.Init(ctx, parameters.n_particles, smooth_radius, spatial_hash_config);
 
     kernel_coeff_id = Simulation::Get().AddUniformDescriptor(ctx, sizeof(KernelCoefficients));
     model_parameter_id = Simulation::Get().AddUniformDescriptor(ctx, sizeof(Parameters));
@@ -95,14 +117,261 @@ void SPHModel::Init(const gfx::CoreCtx& ctx) {
 
     AddBufferToBeReordered(buffers.position_buffer);
     AddBufferToBeReordered(buffers.velocity_buffer);
+
+    for (auto& state : render_states) {
+        state.position_buffer = CreateDataBuffer<glm::vec3>(ctx, parameters.n_particles);
+        state.velocity_buffer = CreateDataBuffer<glm::vec3>(ctx, parameters.n_particles);
+    }
+
+    step_data = CreateDataBuffer<StepData>(ctx, 1);
+
+    time_step_state = CreateDataBuffer<TimeStepState>(ctx, 1);
+    time_step_readback = gfx::CreateReadbackBuffer<TimeStepState>(ctx, 1);
+    *(TimeStepState*)time_step_readback.Map() = {};
+    time_step_pipeline.Init(ctx, {.shader_path = "shaders/compiled/adaptive_time_step.slang.spv",
+                                  .kernels = {"UpdateTimeStep"},
+                                  .push_const_size = sizeof(TimeStepPushConstants)});
+
+    command_cache.Init(ctx);
+    kernel_timer.Init(ctx);
 }
 
-void SPHModel::Step(const gfx::CoreCtx& ctx, VkCommandBuffer cmd) {}
+void SPHModel::Step(const gfx::CoreCtx& ctx, VkCommandBuffer cmd, u32 count) {
+    command_cache.BeginFrame(ctx);
+    pipeline.BeginFrame(ctx);
+
+    if (count == 0)
+        return;
+
+    UpdateSpecialization(ctx);
+
+    if (time_kernels)
+        kernel_timer.BeginFrame(ctx, cmd);
+
+    const auto next_render_state = (render_state_index + 1) % gfx::FRAME_COUNT;
+
+    for (u32 i = 0; i < count; i++) {
+        UpdateStepData(cmd, i == count - 1 ? &render_states[next_render_state] : nullptr);
+
+        // Requests that only apply to the next step (e.g. a forced rebuild) must not end up in the
+        // cached commands, so that step is recorded on its own
+        if (!use_command_cache || spatial_hash.HasPendingReset()) {
+            RecordStepCommands(ctx, cmd, time_kernels && i == 0 ? &kernel_timer : nullptr);
+            continue;
+        }
+
+        if (time_kernels && i == 0) {
+            RecordStepCommands(ctx, cmd, &kernel_timer);
+            continue;
+        }
+
+        const auto state = CurrentRecordedState();
+        if (!command_cache.Valid() || state != recorded_state) {
+            command_cache.Record(ctx, [&](VkCommandBuffer secondary) {
+                RecordStepCommands(ctx, secondary);
+            });
+            recorded_state = state;
+        }
+
+        command_cache.Execute(cmd);
+    }
+
+    // Until the reset time step state is read back the adaptive steps are estimated as well
+    if (!adaptive_time_step.enabled || time_readback_delay > 0)
+        elapsed_time += (float)count * StepTime();
+    if (time_readback_delay > 0)
+        time_readback_delay--;
+
+    render_state_index = next_render_state;
+}
+
+void SPHModel::RecordStepCommands(const gfx::CoreCtx& ctx,
+                                  VkCommandBuffer cmd,
+                                  KernelTimer* timer) {
+    ComputeGraph graph(cmd, timer);
+
+    // Every kernel reads the adaptive time step through the step data
+    if (adaptive_time_step.enabled)
+        graph.AddSharedRead(time_step_state);
+
+    RecordStep(ctx, graph);
+    graph.Flush();
+
+    // Timed steps are serialized, so their counts do not reflect the cached commands
+    if (!timer)
+        graph_stats = graph.GetStats();
+}
+
+void SPHModel::UpdateStepData(VkCommandBuffer cmd, const RenderState* render_state) {
+    auto data = StepData{
+        .time = Platform::Info::GetTime(),
+        .dt = FixedSubstepDt(),
+        .render_positions = render_state ? render_state->position_buffer.device_addr : 0,
+        .render_velocities = render_state ? render_state->velocity_buffer.device_addr : 0,
+        .time_step = adaptive_time_step.enabled ? time_step_state.device_addr : 0,
+    };
+
+    // The previous frame may still be reading it, or writing the time step state
+    auto read_barrier = VkMemoryBarrier2{
+        .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER_2,
+        .srcStageMask = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT,
+        .srcAccessMask = VK_ACCESS_2_SHADER_WRITE_BIT,
+        .dstStageMask = VK_PIPELINE_STAGE_2_TRANSFER_BIT,
+        .dstAccessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT,
+    };
+
+    auto dep_info = VkDependencyInfo{
+        .sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO,
+        .pMemoryBarriers = &read_barrier,
+        .memoryBarrierCount = 1,
+    };
+
+    vkCmdPipelineBarrier2(cmd, &dep_info);
+    vkCmdUpdateBuffer(cmd, step_data.buffer, 0, sizeof(StepData), &data);
+
+    if (adaptive_time_step.enabled && reset_time_step) {
+        auto state = TimeStepState{.dt = FixedSubstepDt(), .time = elapsed_time};
+        vkCmdUpdateBuffer(cmd, time_step_state.buffer, 0, sizeof(TimeStepState), &state);
+        reset_time_step = false;
+        time_readback_delay = gfx::FRAME_COUNT + 1;
+    }
+
+    auto write_barrier = VkMemoryBarrier2{
+        .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER_2,
+        .srcStageMask = VK_PIPELINE_STAGE_2_TRANSFER_BIT,
+        .srcAccessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT,
+        .dstStageMask = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT,
+        .dstAccessMask = VK_ACCESS_2_SHADER_READ_BIT | VK_ACCESS_2_SHADER_WRITE_BIT,
+    };
+
+    dep_info.pMemoryBarriers = &write_barrier;
+    vkCmdPipelineBarrier2(cmd, &dep_info);
+}
+
+float SPHModel::FixedSubstepDt() const {
+    return parameters.time_scale * parameters.fixed_dt / (float)parameters.iterations;
+}
+
+float SPHModel::StepTime() const {
+    if (adaptive_time_step.enabled) {
+        const auto state = LastTimeStep();
+        if (state.dt > 0.0f)
+            return state.dt * (float)parameters.iterations;
+    }
+
+    return parameters.time_scale * parameters.fixed_dt;
+}
+
+void SPHModel::SetAdaptiveTimeStep(const AdaptiveTimeStep& config) {
+    elapsed_time = ElapsedTime();
+    adaptive_time_step = config;
+    reset_time_step = true;
+}
+
+float SPHModel::ElapsedTime() const {
+    if (adaptive_time_step.enabled && time_readback_delay == 0)
+        return LastTimeStep().time;
+
+    return elapsed_time;
+}
+
+void SPHModel::ResetTime() {
+    elapsed_time = 0.0f;
+    reset_time_step = true;
+}
+
+SPHModel::TimeStepState SPHModel::LastTimeStep() const {
+    if (!time_step_readback.buffer)
+        return {};
+
+    time_step_readback.Invalidate();
+    return *(TimeStepState*)time_step_readback.Map();
+}
+
+void SPHModel::DispatchTimeStepUpdate(ComputeGraph& graph) {
+    const auto fixed_dt = FixedSubstepDt();
+    auto push = TimeStepPushConstants{
+        .state = time_step_state.device_addr,
+        .readback = time_step_readback.device_addr,
+        .smooth_radius = smooth_radius,
+        .cfl = adaptive_time_step.cfl,
+        .force_factor = adaptive_time_step.force_factor,
+        .max_growth = adaptive_time_step.max_growth,
+        .min_dt = adaptive_time_step.min_dt_scale * fixed_dt,
+        .max_dt = adaptive_time_step.max_dt_scale * fixed_dt,
+    };
+
+    graph.Dispatch(time_step_pipeline, 0, {1, 1, 1}, &push, {},
+                   {time_step_state, time_step_readback});
+}
+
+void SPHModel::UpdateSpecialization(const gfx::CoreCtx& ctx) {
+    const auto radius = Simulation::Get().GetGlobalParameters().smooth_radius;
+    if (radius != smooth_radius) {
+        smooth_radius = radius;
+        spatial_hash.SetCellSize(radius);
+        spatial_hash.ForceRebuild();
+        UpdateAllUniforms();
+    }
+
+    const auto constants = SpecializationConstants();
+    if (constants != pipeline.Constants()) {
+        pipeline.Specialize(ctx, constants);
+        command_cache.Invalidate();
+    }
+}
+
+std::vector<ComputePipeline::SpecializationConstant> SPHModel::SpecializationConstants() const {
+    const auto radius = specialize_parameters ? smooth_radius : 0.0f;
+
+    return {
+        {.id = 0, .value = group_size},
+        {.id = 1, .value = std::bit_cast<u32>(radius)},
+    };
+}
+
+SPHModel::RecordedState SPHModel::CurrentRecordedState() const {
+    return {
+        .iterations = parameters.iterations,
+        .cell_size = spatial_hash.CellSize(),
+        .verlet_skin = spatial_hash.VerletSkin(),
+        .serialize = ComputeGraph::serialize,
+        .cell_tiles = use_cell_tiles,
+        .neighbor_list = use_neighbor_list,
+        .hash_diagnostics = spatial_hash.DiagnosticsEnabled(),
+        .adaptive_time_step = adaptive_time_step.enabled,
+        .substep_dt = FixedSubstepDt(),
+    };
+}
+
+SPHModel::PushConstants SPHModel::StepPushConstants() const {
+    return {
+        .step_data = step_data.device_addr,
+        .n_particles = (u32)parameters.n_particles,
+    };
+}
 
 void SPHModel::Clear(const gfx::CoreCtx& ctx) {
     spatial_hash.Clear(ctx);
     reorder.Clear(ctx);
 
+    step_data.Destroy();
+    command_cache.Clear(ctx);
+    kernel_timer.Clear(ctx);
+
+    time_step_state.Destroy();
+    time_step_readback.Destroy();
+    time_step_pipeline.Clear(ctx);
+
+    for (auto& state : render_states) {
+        state.position_buffer.Destroy();
+        state.velocity_buffer.Destroy();
+    }
+
+    neighbor_counts.Destroy();
+    neighbor_indices.Destroy();
+    neighbor_stats.Destroy();
+
     buffers.position_buffer.Destroy();
     buffers.velocity_buffer.Destroy();
     buffers.density_buffer.Destroy();
@@ -144,6 +413,16 @@ void SPHModel::SetParticleState(const gfx::Device& gfx,
     gfx.SetDataVec(buffers.position_buffer, pos, offset, count);
     gfx.SetDataVec(buffers.velocity_buffer, vel, offset, count);
     gfx.SetDataVal(buffers.density_buffer, 0.0f, offset, count);
+
+    // Drawn until the next step writes a new one
+    const auto& render_state = GetRenderState();
+    gfx.SetDataVec(render_state.position_buffer, pos, offset, count);
+    gfx.SetDataVec(render_state.velocity_buffer, vel, offset, count);
+
+    spatial_hash.ForceRebuild();
+    ResetNeighborStats();
+    elapsed_time = ElapsedTime();
+    reset_time_step = true;
 }
 
 SPHModel::DataBuffers SPHModel::CreateDataBuffers(const gfx::CoreCtx& ctx) const {
@@ -155,20 +434,6 @@ SPHModel::DataBuffers SPHModel::CreateDataBuffers(const gfx::CoreCtx& ctx) const
     };
 }
 
-void SPHModel::CopyDataBuffers(VkCommandBuffer cmd, DataBuffers& dst) const {
-#define CPY_BUFFER(name)                                                                         \
-    {                                                                                            \
-        auto cpy_info = VkBufferCopy{.dstOffset = 0, .srcOffset = 0, .size = buffers.name.size}; \
-        if (buffers.name.buffer && dst.name.buffer)                                              \
-            vkCmdCopyBuffer(cmd, buffers.name.buffer, dst.name.buffer, 1, &cpy_info);            \
-    }
-
-    CPY_BUFFER(position_buffer);
-    CPY_BUFFER(velocity_buffer);
-    CPY_BUFFER(density_buffer);
-    CPY_BUFFER(accel_buffer);
-}
-
 void SPHModel::AddBufferToBeReordered(const gfx::Buffer& buffer) {
     reorder_buffers.push_back(buffer);
 }
@@ -181,21 +446,35 @@ void SPHModel::InitBufferReorder(const gfx::CoreCtx& ctx) {
                       });
 }
 
+void SPHModel::InitNeighborList(const gfx::CoreCtx& ctx, u32 build_kernel) {
+    const u32 max_neighbors = spatial_hash_config.max_neighbors;
+    if (max_neighbors == 0)
+        return;
+
+    const u32 n = parameters.n_particles;
+    neighbor_list_kernel = build_kernel;
+    neighbor_counts = CreateDataBuffer<u32>(ctx, n);
+    neighbor_indices = CreateDataBuffer<u32>(ctx, (size_t)n * max_neighbors);
+    neighbor_stats = gfx::CreateReadbackBuffer<u32>(ctx, 1);
+    use_neighbor_list = true;
+
+    ResetNeighborStats();
+    spatial_hash.ForceRebuild();
+}
+
+void SPHModel::ResetNeighborStats() {
+    if (neighbor_stats.buffer)
+        *(u32*)neighbor_stats.Map() = 0;
+}
+
 void SPHModel::UpdateAllUniforms() {
     auto& sim = Simulation::Get();
 
-    auto kernel_coeff =
-        CalcKernelCoefficients(Simulation::Get().GetGlobalParameters().smooth_radius);
+    auto kernel_coeff = CalcKernelCoefficients(smooth_radius);
     sim.GetDescManager().SetUniformData(kernel_coeff_id, &kernel_coeff);
     sim.GetDescManager().SetUniformData(model_parameter_id, &parameters);
 
-    auto spatial_hash_bufs = SpatialHashBuffers{
-        .spatial_keys = spatial_hash.SpatialKeysAddr(),
-        .spatial_offsets = spatial_hash.SpatialOffsetsAddr(),
-        .sorted_indices = spatial_hash.SpatialIndicesAddr(),
-    };
-
-    sim.GetDescManager().SetUniformData(spatial_hash_buf_id, &spatial_hash_bufs);
+    UpdateSpatialHashUniforms();
 
     auto model_bufs = ModelBuffers{
         .positions = buffers.position_buffer.device_addr,
@@ -207,19 +486,124 @@ void SPHModel::UpdateAllUniforms() {
     sim.GetDescManager().SetUniformData(model_buffers_id, &model_bufs);
 }
 
-void SPHModel::RunSpatialHash(VkCommandBuffer cmd,
+void SPHModel::UpdateSpatialHashUniforms() {
+    auto spatial_hash_bufs = SpatialHashBuffers{
+        .spatial_keys = spatial_hash.SpatialKeysAddr(),
+        .spatial_offsets = spatial_hash.SpatialOffsetsAddr(),
+        .sorted_indices = spatial_hash.SpatialIndicesAddr(),
+        .reference_positions = spatial_hash.ReferencePositionsAddr(),
+        .cell_size = spatial_hash.CellSize(),
+        .use_reference_positions = spatial_hash.UsesVerletSkin(),
+        .neighbor_counts = neighbor_counts.device_addr,
+        .neighbor_indices = neighbor_indices.device_addr,
+        .neighbor_stats = neighbor_stats.device_addr,
+        .max_neighbors = use_neighbor_list ? spatial_hash_config.max_neighbors : 0,
+        .tile_starts = spatial_hash.TileStartsAddr(),
+        .bucket_ends = spatial_hash.BucketEndsAddr(),
+        .table_mask = spatial_hash.TableSize() - 1,
+    };
+
+    Simulation::Get().GetDescManager().SetUniformData(spatial_hash_buf_id, &spatial_hash_bufs);
+}
+
+void SPHModel::DispatchUpdate(ComputeGraph& graph,
+                              u32 kernel,
+                              int iteration,
+                              std::vector<ComputeGraph::Range> reads,
+                              std::vector<ComputeGraph::Range> writes) {
+    auto push = StepPushConstants();
+    push.last_substep = iteration == parameters.iterations - 1;
+
+    // Either set may be written, depending on the frame
+    if (push.last_substep) {
+        for (const auto& state : render_states) {
+            writes.push_back(state.position_buffer);
+            writes.push_back(state.velocity_buffer);
+        }
+    }
+
+    // Reports the fastest particle for the next time step
+    if (adaptive_time_step.enabled)
+        writes.push_back(time_step_state);
+
+    auto n_groups = glm::ivec3(parameters.n_particles / group_size + 1, 1, 1);
+    graph.Dispatch(pipeline, kernel, n_groups, &push, std::move(reads), std::move(writes));
+
+    if (adaptive_time_step.enabled)
+        DispatchTimeStepUpdate(graph);
+}
+
+void SPHModel::AddBoundaryGridDescriptor() const {
+    Simulation::Get().AddDescriptorInfo({
+        .type = gfx::DescriptorManager::DescType::CombinedImageSampler,
+        .image = boundary_grid_texture,
+    });
+}
+
+void SPHModel::RunSpatialHash(ComputeGraph& graph,
                               const gfx::CoreCtx& ctx,
                               const gfx::Buffer* mod_positions) {
-    if (mod_positions) {
-        spatial_hash.Run(ctx, cmd, mod_positions->device_addr);
+    auto positions =
+        mod_positions ? mod_positions->device_addr : buffers.position_buffer.device_addr;
+
+    graph.BeginScope("Spatial hash");
+
+    spatial_hash.BeginRebuild(graph, positions);
+    spatial_hash.Run(ctx, graph, positions);
+
+    reorder.Reorder(graph, ctx);
+
+    if (spatial_hash.UsesVerletSkin() || use_neighbor_list) {
+        // The copy has to be skipped together with the rest of the rebuild, and the neighbor list
+        // reads the reordered positions right after
+        reorder.CopybackDispatch(graph);
     } else {
-        spatial_hash.Run(ctx, cmd, buffers.position_buffer.device_addr);
+        graph.Barrier();
+        reorder.Copyback(graph.Cmd());
+        graph.Barrier();
+    }
+
+    if (use_neighbor_list) {
+        auto push = StepPushConstants();
+        auto reads = spatial_hash.NeighborSearchRanges();
+        reads.push_back(buffers.position_buffer);
+
+        graph.Dispatch(pipeline, *neighbor_list_kernel,
+                       {parameters.n_particles / group_size + 1, 1, 1}, &push, std::move(reads),
+                       {neighbor_counts, neighbor_indices, neighbor_stats});
+    }
+
+    spatial_hash.EndRebuild(graph, positions);
+
+    graph.EndScope();
+}
+
+void SPHModel::ComputeNeighborKernel(ComputeGraph& graph,
+                                     u32 kernel,
+                                     u32 tiled_kernel,
+                                     PushConstants* push,
+                                     std::vector<ComputeGraph::Range> reads,
+                                     std::vector<ComputeGraph::Range> writes) {
+    if (has_tiled_kernels && use_cell_tiles && spatial_hash.UsesCellTiles()) {
+        graph.DispatchIndirect(pipeline, tiled_kernel, spatial_hash.TileDispatchBuffer(), push,
+                               NeighborReads(std::move(reads)), std::move(writes));
+    } else {
+        graph.Dispatch(pipeline, kernel, {parameters.n_particles / group_size + 1, 1, 1}, push,
+                       NeighborReads(std::move(reads)), std::move(writes));
+    }
+}
+
+std::vector<ComputeGraph::Range> SPHModel::NeighborReads(
+    std::vector<ComputeGraph::Range> reads) const {
+    const auto hash_ranges = spatial_hash.NeighborSearchRanges();
+    reads.insert(reads.end(), hash_ranges.begin(), hash_ranges.end());
+
+    if (use_neighbor_list) {
+        reads.push_back(neighbor_counts);
+        reads.push_back(neighbor_indices);
     }
 
-    ComputeToComputePipelineBarrier(cmd);
-    reorder.Reorder(cmd, ctx);
-    ComputeToComputePipelineBarrier(cmd);
-    reorder.Copyback(cmd);
+    return reads;
 }
 
 SPHModel::KernelCoefficients SPHModel::CalcKernelCoefficients(float r) {
@@ -260,7 +644,184 @@ void SPHModel::DrawDebugUI() {
             SetBoundingBoxSize(size);
             sim.GetDescManager().SetUniformData(model_parameter_id, &parameters);
         }
+
+        if (spatial_hash.SupportsVerletSkin()) {
+            float skin = spatial_hash.VerletSkin();
+            if (ImGui::DragFloat("Verlet skin", &skin, 0.001f, 0.0f,
+                                 sim.GetGlobalParameters().smooth_radius)) {
+                spatial_hash.SetVerletSkin(skin);
+                UpdateSpatialHashUniforms();
+            }
+        } else {
+            ImGui::TextDisabled("Verlet skin not supported on this device");
+        }
+
+        if (spatial_hash.UsesIncrementalSort()) {
+            auto stats = spatial_hash.IncrementalSortStats();
+            ImGui::Text("Last sort: %s, %.2f%% of particles moved",
+                        stats.incremental ? "incremental" : "full",
+                        100.0f * (float)stats.movers / (float)parameters.n_particles);
+        }
+
+        bool hash_diagnostics = spatial_hash.DiagnosticsEnabled();
+        if (ImGui::Checkbox("Hash diagnostics", &hash_diagnostics)) {
+            spatial_hash.SetDiagnostics(hash_diagnostics);
+        }
+
+        if (hash_diagnostics) {
+            const auto diag = spatial_hash.LastDiagnostics();
+            const u32 table_size = spatial_hash.TableSize();
+            ImGui::Text("Table: %u buckets, %.1f%% occupied", table_size,
+                        100.0f * (float)diag.occupied_buckets / (float)table_size);
+            ImGui::Text("Chain length: %.2f average, %u max",
+                        diag.occupied_buckets > 0
+                            ? (float)parameters.n_particles / (float)diag.occupied_buckets
+                            : 0.0f,
+                        diag.max_chain_length);
+            ImGui::Text("Colliding particles: %.2f%%",
+                        100.0f * (float)diag.colliding_particles / (float)parameters.n_particles);
+        }
+
+        DrawAdaptiveTimeStepUI();
+
+        ImGui::Checkbox("Cache step commands", &use_command_cache);
+        ImGui::SameLine();
+        ImGui::TextDisabled("(recorded %u times)", command_cache.RecordCount());
+
+        ImGui::Checkbox("Serialize compute passes", &ComputeGraph::serialize);
+
+        ImGui::Checkbox("Specialize parameters", &specialize_parameters);
+        ImGui::SameLine();
+        ImGui::TextDisabled("(%u pipeline variants)", pipeline.VariantCount());
+
+        // Only the sizes the device can run
+        if (ImGui::BeginCombo("Workgroup size", std::to_string(group_size).c_str())) {
+            for (u32 size : {64u, 128u, 256u, 512u}) {
+                if (size > max_group_size)
+                    continue;
+
+                if (ImGui::Selectable(std::to_string(size).c_str(), size == group_size))
+                    group_size = size;
+            }
+            ImGui::EndCombo();
+        }
+        ImGui::Text("Last step: %u dispatches, %u barriers", graph_stats.dispatches,
+                    graph_stats.barriers);
+
+        if (has_tiled_kernels && spatial_hash.UsesCellTiles()) {
+            ImGui::Checkbox("Cell-tiled kernels", &use_cell_tiles);
+        }
+
+        if (neighbor_list_kernel) {
+            if (ImGui::Checkbox("Neighbor list", &use_neighbor_list)) {
+                ResetNeighborStats();
+                spatial_hash.ForceRebuild();
+                UpdateSpatialHashUniforms();
+            }
+
+            const float size_mb =
+                (float)(neighbor_counts.size + neighbor_indices.size) / (1024.0f * 1024.0f);
+            neighbor_stats.Invalidate();
+            const u32 peak = *(u32*)neighbor_stats.Map();
+
+            ImGui::Text("%.1f MB, up to %u neighbors, max seen %u%s", size_mb,
+                        spatial_hash_config.max_neighbors, peak,
+                        peak > spatial_hash_config.max_neighbors ? " (overflow uses hash walk)"
+                                                                 : "");
+            ImGui::SameLine();
+            if (ImGui::SmallButton("Reset max"))
+                ResetNeighborStats();
+        }
     }
+
+    DrawKernelTimings();
+}
+
+void SPHModel::DrawAdaptiveTimeStepUI() {
+    const auto elapsed = ElapsedTime();
+    if (ImGui::Checkbox("Adaptive time step", &adaptive_time_step.enabled)) {
+        elapsed_time = elapsed;
+        reset_time_step = true;
+    }
+
+    if (!adaptive_time_step.enabled)
+        return;
+
+    // The bounds and factors are baked into the recorded step commands
+    auto changed = ImGui::DragFloat("CFL number", &adaptive_time_step.cfl, 0.01f, 0.01f, 1.0f);
+    changed |= ImGui::DragFloat("Force factor", &adaptive_time_step.force_factor, 0.01f, 0.01f,
+                                1.0f);
+    changed |= ImGui::DragFloat("Max growth", &adaptive_time_step.max_growth, 0.01f, 1.0f, 2.0f);
+    changed |= ImGui::DragFloatRange2("Delta-t bounds", &adaptive_time_step.min_dt_scale,
+                                      &adaptive_time_step.max_dt_scale, 0.01f, 0.01f, 10.0f,
+                                      "%.2fx", "%.2fx");
+    if (changed)
+        InvalidateStepCommands();
+
+    const auto state = LastTimeStep();
+    ImGui::Text("Substep delta-t: %.3f ms (fixed %.3f ms)", state.dt * 1e3f,
+                FixedSubstepDt() * 1e3f);
+    ImGui::Text("Simulated time: %.3f s", state.time);
+}
+
+void SPHModel::DrawKernelTimings() {
+    if (!ImGui::CollapsingHeader("GPU profiler"))
+        return;
+
+    if (!kernel_timer.Supported()) {
+        ImGui::TextDisabled("Timestamp queries not supported on this device");
+        return;
+    }
+
+    ImGui::Checkbox("Time kernels", &time_kernels);
+    if (!time_kernels)
+        return;
+
+    ImGui::Text("Step total: %.3f ms (serialized)", kernel_timer.TotalMs());
+
+    // Compares models that run at different time steps
+    const auto step_time = StepTime();
+    if (step_time > 0.0f)
+        ImGui::Text("Per simulated second: %.1f ms", kernel_timer.TotalMs() / step_time);
+
+    if (ImGui::Button("Export CSV"))
+        kernel_timer.ExportCSV("kernel_timings.csv");
+    ImGui::SameLine();
+    if (ImGui::Button("Export trace"))
+        kernel_timer.ExportTrace("kernel_trace.json");
+
+    const auto flags = ImGuiTableFlags_RowBg | ImGuiTableFlags_BordersInnerV;
+    if (!ImGui::BeginTable("Kernel timings", 5, flags))
+        return;
+
+    ImGui::TableSetupColumn("Kernel");
+    ImGui::TableSetupColumn("Mean ms");
+    ImGui::TableSetupColumn("Min");
+    ImGui::TableSetupColumn("Max");
+    ImGui::TableSetupColumn("Calls");
+    ImGui::TableHeadersRow();
+
+    for (const auto& timing : kernel_timer.Results()) {
+        ImGui::TableNextRow();
+        ImGui::TableNextColumn();
+        // Kernels inside a scope are indented under it
+        const auto indent = (float)timing.depth * ImGui::GetStyle().IndentSpacing;
+        if (indent > 0.0f)
+            ImGui::Indent(indent);
+        ImGui::TextUnformatted(timing.name.c_str());
+        if (indent > 0.0f)
+            ImGui::Unindent(indent);
+        ImGui::TableNextColumn();
+        ImGui::Text("%.3f", timing.mean_ms);
+        ImGui::TableNextColumn();
+        ImGui::Text("%.3f", timing.min_ms);
+        ImGui::TableNextColumn();
+        ImGui::Text("%.3f", timing.max_ms);
+        ImGui::TableNextColumn();
+        ImGui::Text("%u", timing.count);
+    }
+
+    ImGui::EndTable();
 }
 
 }  // namespace vfs
@@ -1,10 +1,15 @@
 #pragma once
 #include <optional>
 
+#include "compute/compute_graph.h"
 #include "compute/compute_pipeline.h"
+#include "compute/kernel_timer.h"
+#include "compute/solver_loop.h"
 #include "compute/sort.h"
 #include "compute/spatial_hash.h"
+#include "gfx/command_cache.h"
 #include "gfx/common.h"
+#include "gfx/descriptor.h"
 #include "gfx/gfx.h"
 #include "gfx/mesh.h"
 
@@ -33,6 +38,16 @@ public:
         VkDeviceAddress spatial_keys;
         VkDeviceAddress spatial_offsets;
         VkDeviceAddress sorted_indices;
+        VkDeviceAddress reference_positions;
+        float cell_size;
+        u32 use_reference_positions;
+        VkDeviceAddress neighbor_counts;
+        VkDeviceAddress neighbor_indices;
+        VkDeviceAddress neighbor_stats;
+        u32 max_neighbors;
+        VkDeviceAddress tile_starts;
+        VkDeviceAddress bucket_ends;
+        u32 table_mask;
     };
 
     struct DataBuffers {
@@ -49,16 +64,56 @@ public:
         VkDeviceAddress accelerations;
     };
 
-    struct PushConstants {
+    struct StepData {
         float time;
         float dt;
+        VkDeviceAddress render_positions;
+        VkDeviceAddress render_velocities;
+        // Replaces dt when set
+        VkDeviceAddress time_step;
+    };
+
+    // Same layout as in the shaders
+    struct TimeStepState {
+        u32 max_sqr_speed;
+        u32 max_sqr_accel;
+        float dt;
+        float time;
+    };
+
+    // Time step chosen on the GPU after every substep from the fastest particle (CFL condition) and
+    // the largest acceleration, so the CPU never waits for it
+    struct AdaptiveTimeStep {
+        bool enabled{false};
+        // Largest fraction of the smooth radius a particle may travel in one substep
+        float cfl{0.4f};
+        // Scales the acceleration criterion sqrt(h / |a|)
+        float force_factor{0.25f};
+        // Largest ratio between consecutive time steps
+        float max_growth{1.2f};
+        // Bounds as multiples of the fixed substep time step
+        float min_dt_scale{0.05f};
+        float max_dt_scale{4.0f};
+    };
+
+    struct PushConstants {
+        VkDeviceAddress step_data;
         unsigned n_particles;
+        u32 last_substep;
+    };
+
+    // Particle state drawn by the renderer. The last step of every frame writes it into the set
+    // that was not drawn last, so it is never copied and frames in flight keep their own.
+    struct RenderState {
+        gfx::Buffer position_buffer;
+        gfx::Buffer velocity_buffer;
     };
 
     SPHModel(const Parameters* parameters = nullptr);
 
     virtual void Init(const gfx::CoreCtx& ctx);
-    virtual void Step(const gfx::CoreCtx& ctx, VkCommandBuffer cmd);
+    // Records `count` consecutive steps into the frame's command buffer
+    virtual void Step(const gfx::CoreCtx& ctx, VkCommandBuffer cmd, u32 count = 1);
     virtual void Clear(const gfx::CoreCtx& ctx);
     virtual void DrawDebugUI();
     virtual ~SPHModel() = default;
@@ -66,6 +121,8 @@ public:
     auto GetBoundingBox() const { return bounding_box; }
     const Parameters& GetParameters() const { return parameters; }
     const DataBuffers& GetDataBuffers() const { return buffers; }
+    // Set written by the last recorded frame that stepped the simulation
+    const RenderState& GetRenderState() const { return render_states[render_state_index]; }
 
     enum class ParticleInBoxMode { Random, Compact };
 
@@ -74,14 +131,41 @@ public:
                            u32 offset = 0,
                            i64 count = -1,
                            ParticleInBoxMode mode = ParticleInBoxMode::Compact);
-    void SetParticleState(const gfx::Device& gfx,
-                          const std::vector<glm::vec3>& pos,
-                          const std::vector<glm::vec3>& vel,
-                          u32 offset = 0,
-                          i64 count = -1);
+    // Models with more per-particle state reset it here too
+    virtual void SetParticleState(const gfx::Device& gfx,
+                                  const std::vector<glm::vec3>& pos,
+                                  const std::vector<glm::vec3>& vel,
+                                  u32 offset = 0,
+                                  i64 count = -1);
     void SetBoundingBoxSize(const glm::vec3& size);
+    void SetSpatialHashConfig(const SpatialHash::Config& config) { spatial_hash_config = config; }
+    // Filtered copy of the mesh grids of the boundary objects, set before Init by the scenes that
+    // create models with boundary objects
+    void SetBoundaryGridTexture(const gfx::DescriptorManager::ImageData& texture) {
+        boundary_grid_texture = texture;
+    }
+    void SetAdaptiveTimeStep(const AdaptiveTimeStep& config);
+
+    // Simulated time advanced by one step. With adaptive time steps it is estimated from the last
+    // substep that was read back.
+    float StepTime() const;
+    // Simulated time since the last reset. Adaptive substeps are summed on the GPU and read back
+    // without waiting, so they are counted a few frames late.
+    float ElapsedTime() const;
+    void ResetTime();
+
+    struct SolverStats {
+        std::string name;
+        GPUSolverLoop::Stats stats;
+    };
+
+    // Last solve of every iterative solver of the model, read back without waiting
+    virtual std::vector<SolverStats> LastSolverStats() const { return {}; }
+
+    // Same as the "Time kernels" checkbox
+    void SetKernelTiming(bool enabled) { time_kernels = enabled; }
+    const KernelTimer& GetKernelTimer() const { return kernel_timer; }
 
-    void CopyDataBuffers(VkCommandBuffer cmd, DataBuffers& dst) const;
     DataBuffers CreateDataBuffers(const gfx::CoreCtx& ctx) const;
 
 protected:
@@ -90,7 +174,15 @@ protected:
     Parameters parameters;
     std::optional<gfx::BoundingBox> bounding_box;
     SpatialHash spatial_hash;
+    SpatialHash::Config spatial_hash_config;
+    gfx::DescriptorManager::ImageData boundary_grid_texture{};
     u32 group_size{256};
+    // Largest 1D workgroup of the device
+    u32 max_group_size{256};
+    // Folds parameters that rarely change (e.g. the smooth radius) into the kernels as
+    // specialization constants. The kernels are rebuilt, or taken from the pipeline's variants,
+    // when they change.
+    bool specialize_parameters{true};
 
     u32 kernel_coeff_id;
     u32 model_parameter_id;
@@ -98,18 +190,132 @@ protected:
     u32 model_buffers_id;
 
     void UpdateAllUniforms();
+    void UpdateSpatialHashUniforms();
+
+    // Constants the pipeline is built with. Models add their own ids after the base ones.
+    virtual std::vector<ComputePipeline::SpecializationConstant> SpecializationConstants() const;
+
+    // Records the substeps of a frame. The commands are cached and replayed by Step until a
+    // parameter that changes them is edited, so everything that varies per frame has to be read
+    // from buffers (e.g. the step data) instead of push constants.
+    virtual void RecordStep(const gfx::CoreCtx& ctx, ComputeGraph& graph) {}
+    PushConstants StepPushConstants() const;
 
     void AddBufferToBeReordered(const gfx::Buffer& buffer);
     void InitBufferReorder(const gfx::CoreCtx& ctx);
 
-    void RunSpatialHash(VkCommandBuffer cmd,
+    // Models whose kernels read neighbors through ForEachNeighbor register the kernel that builds
+    // the list. It is allocated only if the spatial hash config asks for one.
+    void InitNeighborList(const gfx::CoreCtx& ctx, u32 build_kernel);
+
+    // Dispatches the cell-tiled variant of a neighbor kernel (one workgroup per non-empty bucket)
+    // when the spatial hash builds cell tiles and they are enabled, the per-particle one otherwise.
+    // Models set has_tiled_kernels when they provide the variants.
+    void ComputeNeighborKernel(ComputeGraph& graph,
+                               u32 kernel,
+                               u32 tiled_kernel,
+                               PushConstants* push,
+                               std::vector<ComputeGraph::Range> reads,
+                               std::vector<ComputeGraph::Range> writes);
+    bool has_tiled_kernels{false};
+
+    // Adds the spatial hash and neighbor list buffers to the reads of a kernel that visits neighbors
+    std::vector<ComputeGraph::Range> NeighborReads(std::vector<ComputeGraph::Range> reads) const;
+
+    // Dispatches the kernel that integrates the positions in substep `iteration`. On the last
+    // substep it also writes the render state, when the step data points to one. With adaptive
+    // time steps it is followed by the update of the time step.
+    void DispatchUpdate(ComputeGraph& graph,
+                        u32 kernel,
+                        int iteration,
+                        std::vector<ComputeGraph::Range> reads,
+                        std::vector<ComputeGraph::Range> writes);
+
+    // Binds the boundary grid texture after the uniforms the model has added
+    void AddBoundaryGridDescriptor() const;
+
+    void RunSpatialHash(ComputeGraph& graph,
                         const gfx::CoreCtx& ctx,
                         const gfx::Buffer* mod_positions = nullptr);
 
+    // Dispatch and barrier counts of the last recorded step, set by the models
+    ComputeGraph::Stats graph_stats{};
+
+    // Must be called when a model setting changes the recorded step commands
+    void InvalidateStepCommands() { command_cache.Invalidate(); }
+
     KernelCoefficients CalcKernelCoefficients(float r);
 
 private:
+    // Everything baked into the recorded step commands
+    struct RecordedState {
+        int iterations;
+        float cell_size;
+        float verlet_skin;
+        bool serialize;
+        bool cell_tiles;
+        bool neighbor_list;
+        bool hash_diagnostics;
+        bool adaptive_time_step;
+        // Bounds the adaptive time step
+        float substep_dt;
+
+        bool operator==(const RecordedState&) const = default;
+    };
+
+    gfx::Buffer step_data;
+    gfx::CommandCache command_cache;
+    RecordedState recorded_state{};
+    bool use_command_cache{true};
+
+    std::array<RenderState, gfx::FRAME_COUNT> render_states;
+    u32 render_state_index{0};
+
+    RecordedState CurrentRecordedState() const;
+    // Applies a change of smooth radius or of the specialization constants before recording
+    void UpdateSpecialization(const gfx::CoreCtx& ctx);
+    float smooth_radius{0.0f};
+    void UpdateStepData(VkCommandBuffer cmd, const RenderState* render_state);
+    // Time step of a substep when it is not adaptive
+    float FixedSubstepDt() const;
+
+    AdaptiveTimeStep adaptive_time_step;
+    ComputePipeline time_step_pipeline;
+    gfx::Buffer time_step_state;
+    gfx::Buffer time_step_readback;
+    // Restarts from the fixed time step with the next step, e.g. after the particles are reset
+    bool reset_time_step{true};
+    // Time of the fixed steps, and of the adaptive ones until the GPU sum can be read back
+    float elapsed_time{0.0f};
+    // Frames until the readback reflects the last reset of the time step state
+    u32 time_readback_delay{0};
+    void DispatchTimeStepUpdate(ComputeGraph& graph);
+    TimeStepState LastTimeStep() const;
+    void DrawAdaptiveTimeStepUI();
+    void RecordStepCommands(const gfx::CoreCtx& ctx,
+                            VkCommandBuffer cmd,
+                            KernelTimer* timer = nullptr);
+
+    // Times the dispatches of the first step of every frame. Timestamps cannot be replayed from
+    // the cached commands, so that step is recorded directly while enabled.
+    KernelTimer kernel_timer;
+    bool time_kernels{false};
+    void DrawKernelTimings();
+
     BufferReorder reorder;
     std::vector<BufferReorder::Config::BufferInfo> reorder_buffers;
+
+    // The tiled kernels are not measured against the per-particle ones yet, so they only run once
+    // turned on from the UI
+    bool use_cell_tiles{false};
+
+    std::optional<u32> neighbor_list_kernel;
+    bool use_neighbor_list{false};
+    gfx::Buffer neighbor_counts;
+    gfx::Buffer neighbor_indices;
+    // Largest neighbor count found by the list builds since the particles were set or it was reset
+    gfx::Buffer neighbor_stats;
+
+    void ResetNeighborStats();
 };
 }  // namespace vfs
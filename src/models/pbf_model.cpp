@@ -0,0 +1,172 @@
+#include "pbf_model.h"
+
+#include "imgui.h"
+#include "simulation.h"
+
+namespace vfs {
+
+namespace {
+enum SimKernel : u32 {
+    KernelUpdatePositions = 0,
+    KernelPredictPositions,
+    KernelComputeLambda,
+    KernelComputeCorrection,
+    KernelApplyCorrection,
+    KernelUpdateVelocities,
+    KernelXSPHViscosity,
+};
+
+struct PBFBuffers {
+    VkDeviceAddress predicted_positions;
+    VkDeviceAddress lambdas;
+    VkDeviceAddress corrections;
+    VkDeviceAddress boundary_gradient;
+};
+}  // namespace
+
+PBFModel::PBFModel(const SPHModel::Parameters* base_par, const Parameters* par)
+    : SPHModel(base_par) {
+    if (par)
+        parameters = *par;
+}
+
+void PBFModel::Init(const gfx::CoreCtx& ctx) {
+    SPHModel::Init(ctx);
+
+    const auto n = (u32)SPHModel::parameters.n_particles;
+    predicted_positions = CreateDataBuffer<glm::vec3>(ctx, n);
+    lambdas = CreateDataBuffer<float>(ctx, n);
+    corrections = CreateDataBuffer<glm::vec3>(ctx, n);
+    boundary_gradient = CreateDataBuffer<glm::vec3>(ctx, n);
+
+    AddBufferToBeReordered(predicted_positions);
+    InitBufferReorder(ctx);
+
+    auto& sim = Simulation::Get();
+    parameter_id = sim.AddUniformDescriptor(ctx, sizeof(Parameters));
+    buf_id = sim.AddUniformDescriptor(ctx, sizeof(PBFBuffers));
+    AddBoundaryGridDescriptor();
+
+    sim.InitDescriptorManager(ctx);
+
+    sim.GetDescManager().SetUniformData(parameter_id, &parameters);
+
+    auto pbf_bufs = PBFBuffers{
+        .predicted_positions = predicted_positions.device_addr,
+        .lambdas = lambdas.device_addr,
+        .corrections = corrections.device_addr,
+        .boundary_gradient = boundary_gradient.device_addr,
+    };
+
+    sim.GetDescManager().SetUniformData(buf_id, &pbf_bufs);
+
+    pipeline.Init(ctx, {
+                           .push_const_size = sizeof(SPHModel::PushConstants),
+                           .set = sim.GetDescManager().Set(),
+                           .layout = sim.GetDescManager().Layout(),
+                           .shader_path = "shaders/compiled/pbf_model.slang.spv",
+                           .kernels =
+                               {
+                                   "UpdatePositions",
+                                   "PredictPositions",
+                                   "ComputeLambda",
+                                   "ComputeCorrection",
+                                   "ApplyCorrection",
+                                   "UpdateVelocities",
+                                   "XSPHViscosity",
+                               },
+                           .constants = SpecializationConstants(),
+                       });
+
+    UpdateAllUniforms();
+}
+
+void PBFModel::RecordStep(const gfx::CoreCtx& ctx, ComputeGraph& graph) {
+    auto push = StepPushConstants();
+
+    auto n_groups = glm::ivec3(SPHModel::parameters.n_particles / group_size + 1, 1, 1);
+
+    const auto& b = buffers;
+
+    for (int i = 0; i < SPHModel::parameters.iterations; i++) {
+        graph.Dispatch(pipeline, KernelPredictPositions, n_groups, &push,
+                       {b.position_buffer, b.velocity_buffer},
+                       {b.velocity_buffer, predicted_positions});
+
+        // The neighbors are found around the predicted positions, as in the Lague model
+        RunSpatialHash(graph, ctx, &predicted_positions);
+
+        graph.BeginScope("Constraint projection");
+        for (u32 it = 0; it < parameters.constraint_iterations; it++) {
+            graph.Dispatch(pipeline, KernelComputeLambda, n_groups, &push,
+                           NeighborReads({predicted_positions}),
+                           {lambdas, b.density_buffer, boundary_gradient});
+            graph.Dispatch(pipeline, KernelComputeCorrection, n_groups, &push,
+                           NeighborReads({predicted_positions, lambdas, boundary_gradient}),
+                           {corrections});
+            graph.Dispatch(pipeline, KernelApplyCorrection, n_groups, &push, {corrections},
+                           {predicted_positions});
+        }
+        graph.EndScope();
+
+        graph.Dispatch(pipeline, KernelUpdateVelocities, n_groups, &push,
+                       {b.position_buffer, predicted_positions, b.velocity_buffer},
+                       {b.velocity_buffer, b.accel_buffer});
+
+        graph.Dispatch(pipeline, KernelXSPHViscosity, n_groups, &push,
+                       NeighborReads({predicted_positions, b.velocity_buffer}), {corrections});
+
+        DispatchUpdate(graph, KernelUpdatePositions, i,
+                       {predicted_positions, corrections, b.accel_buffer},
+                       {b.position_buffer, b.velocity_buffer});
+    }
+}
+
+std::vector<ComputePipeline::SpecializationConstant> PBFModel::SpecializationConstants() const {
+    auto constants = SPHModel::SpecializationConstants();
+
+    // Fixed by the scene, so the boundary handling is compiled out when there are no objects
+    if (specialize_parameters)
+        constants.push_back({.id = 2, .value = parameters.n_boundary_objects});
+
+    return constants;
+}
+
+void PBFModel::Clear(const gfx::CoreCtx& ctx) {
+    SPHModel::Clear(ctx);
+
+    predicted_positions.Destroy();
+    lambdas.Destroy();
+    corrections.Destroy();
+    boundary_gradient.Destroy();
+}
+
+void PBFModel::DrawDebugUI() {
+    SPHModel::DrawDebugUI();
+
+    auto& sim = Simulation::Get();
+
+    if (ImGui::CollapsingHeader("PBF model")) {
+        auto changed = ImGui::DragFloat("Relaxation", &parameters.relaxation, 0.01f, 1e-3f,
+                                        100.0f, "%.3f", ImGuiSliderFlags_Logarithmic);
+        changed |= ImGui::DragFloat("Artificial pressure", &parameters.artificial_pressure,
+                                    0.001f, 0.0f, 1.0f);
+        changed |= ImGui::DragFloat("Artificial pressure radius",
+                                    &parameters.artificial_pressure_radius, 0.01f, 0.05f, 0.5f);
+        changed |= ImGui::DragFloat("Artificial pressure exponent",
+                                    &parameters.artificial_pressure_exponent, 0.1f, 1.0f, 8.0f);
+        changed |= ImGui::DragFloat("XSPH viscosity", &parameters.xsph_viscosity, 0.001f, 0.0f,
+                                    1.0f);
+        if (changed)
+            sim.GetDescManager().SetUniformData(parameter_id, &parameters);
+
+        const u32 min_iterations = 1;
+        const u32 max_iterations = 20;
+        if (ImGui::DragScalar("Constraint iterations", ImGuiDataType_U32,
+                              &parameters.constraint_iterations, 0.1f, &min_iterations,
+                              &max_iterations)) {
+            InvalidateStepCommands();
+        }
+    }
+}
+}  // namespace vfs
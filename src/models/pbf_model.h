@@ -0,0 +1,49 @@
+#pragma once
+
+#include "gfx/common.h"
+#include "models/model.h"
+#include "models/volume_map_boundary.h"
+
+namespace vfs {
+/*
+ * This model is based on the work by M. Macklin and M. Müller, “Position based fluids,” ACM
+ * Transactions on Graphics, vol. 32, no. 4, pp. 104:1–104:12, July 2013.
+ */
+class PBFModel final : public SPHModel {
+public:
+    struct Parameters {
+        float relaxation{1.0f};
+        float artificial_pressure{0.1f};
+        float artificial_pressure_radius{0.2f};
+        float artificial_pressure_exponent{4.0f};
+        float xsph_viscosity{0.01f};
+        VkDeviceAddress boundary_objects{0};
+        u32 n_boundary_objects{0};
+        VkDeviceAddress boundary_candidates{0};
+        // Projections of the density constraints per substep
+        u32 constraint_iterations{4};
+    };
+
+    PBFModel(const SPHModel::Parameters* sph_parameters = nullptr,
+             const Parameters* parameters = nullptr);
+
+    void Init(const gfx::CoreCtx& ctx) override;
+    void Clear(const gfx::CoreCtx& ctx) override;
+    void DrawDebugUI() override;
+
+protected:
+    void RecordStep(const gfx::CoreCtx& ctx, ComputeGraph& graph) override;
+    std::vector<ComputePipeline::SpecializationConstant> SpecializationConstants() const override;
+
+private:
+    u32 parameter_id{0};
+    Parameters parameters;
+
+    u32 buf_id{0};
+    gfx::Buffer predicted_positions;
+    gfx::Buffer lambdas;
+    gfx::Buffer corrections;
+    gfx::Buffer boundary_gradient;
+};
+
+}  // namespace vfs
@@ -0,0 +1,55 @@
+#pragma once
+
+#include "gfx/common.h"
+#include "gfx/mesh.h"
+
+namespace vfs {
+
+// Same values as in volume_map_boundary.slang. Meshes are sampled from their SDF and volume map
+// grids, heightfields from a 2D grid of heights, and the other shapes are evaluated in closed form.
+enum class BoundaryShape : u32 {
+    Mesh = 0,
+    // Half extents in the size
+    Box,
+    // Radius in size.x
+    Sphere,
+    // Radius in size.x and half length of the segment along local y in size.y
+    Capsule,
+    // Radius in size.x and half height along local y in size.y
+    Cylinder,
+    // Solid below local y = 0
+    Plane,
+    // Heights in [0, 1] over local x in [0, size.x] and z in [0, size.z], scaled by size.y. Solid
+    // below the surface.
+    Heightfield,
+};
+
+// Solid object sampled by the models with volume map boundaries, same layout as in
+// volume_map_boundary.slang. Meshes packed in the grid texture have a non-zero texture_scale.
+struct BoundaryObjectInfo {
+    glm::mat4x4 transform;
+    glm::mat4x4 rotation;
+    gfx::BoundingBox box;
+
+    VkDeviceAddress sdf_grid;
+    VkDeviceAddress volume_map_grid;
+    glm::uvec3 resolution;
+
+    BoundaryShape shape;
+    glm::vec3 size;
+
+    glm::vec3 texture_offset;
+    glm::vec3 texture_scale;
+};
+
+// Candidate objects of the cells of a uniform grid, same layout as in volume_map_boundary.slang
+struct BoundaryCandidates {
+    gfx::BoundingBox box;
+    glm::uvec3 resolution;
+    float cell_size;
+    u32 max_per_cell;
+    VkDeviceAddress counts;
+    VkDeviceAddress objects;
+};
+
+}  // namespace vfs
@@ -13,6 +13,9 @@ enum SimKernel : u32 {
     KernelCalculateDensities,
     KernelCalculatePressureForces,
     KernelCalculateViscousForces,
+    KernelCalculateDensitiesTiled,
+    KernelCalculatePressureForcesTiled,
+    KernelCalculateViscousForcesTiled,
 };
 
 WCSPHModel::WCSPHModel(const SPHModel::Parameters* base_par, const Parameters* par)
@@ -50,44 +53,43 @@ void WCSPHModel::Init(const gfx::CoreCtx& ctx) {
                                    "CalculateDensities",
                                    "CalculatePressureForces",
                                    "CalculateViscousForces",
+                                   "CalculateDensitiesTiled",
+                                   "CalculatePressureForcesTiled",
+                                   "CalculateViscousForcesTiled",
                                },
+                           .constants = SpecializationConstants(),
                        });
+    has_tiled_kernels = true;
 
     UpdateAllUniforms();
 }
 
-void WCSPHModel::Step(const gfx::CoreCtx& ctx, VkCommandBuffer cmd) {
-    SPHModel::Step(ctx, cmd);
-
-    auto push = PushConstants{
-        .time = Platform::Info::GetTime(),
-        .dt = SPHModel::parameters.time_scale * SPHModel::parameters.fixed_dt /
-              (float)SPHModel::parameters.iterations,
-        .n_particles = (uint32_t)SPHModel::parameters.n_particles,
-    };
+void WCSPHModel::RecordStep(const gfx::CoreCtx& ctx, ComputeGraph& graph) {
+    auto push = StepPushConstants();
 
     auto n_groups = glm::ivec3(SPHModel::parameters.n_particles / group_size + 1, 1, 1);
 
-    for (int i = 0; i < SPHModel::parameters.iterations; i++) {
-        if (i > 0)
-            ComputeToComputePipelineBarrier(cmd);
+    const auto& b = buffers;
 
-        pipeline.Compute(cmd, KernelExternalForces, n_groups, &push);
-        ComputeToComputePipelineBarrier(cmd);
+    for (int i = 0; i < SPHModel::parameters.iterations; i++) {
+        graph.Dispatch(pipeline, KernelExternalForces, n_groups, &push,
+                       {b.position_buffer, b.velocity_buffer}, {b.accel_buffer});
 
-        RunSpatialHash(cmd, ctx);
-        ComputeToComputePipelineBarrier(cmd);
+        RunSpatialHash(graph, ctx);
 
-        pipeline.Compute(cmd, KernelCalculateDensities, n_groups, &push);
-        ComputeToComputePipelineBarrier(cmd);
+        ComputeNeighborKernel(graph, KernelCalculateDensities, KernelCalculateDensitiesTiled, &push,
+                              {b.position_buffer}, {b.density_buffer});
 
-        pipeline.Compute(cmd, KernelCalculatePressureForces, n_groups, &push);
-        ComputeToComputePipelineBarrier(cmd);
+        ComputeNeighborKernel(graph, KernelCalculatePressureForces,
+                              KernelCalculatePressureForcesTiled, &push,
+                              {b.position_buffer, b.density_buffer}, {b.accel_buffer});
 
-        pipeline.Compute(cmd, KernelCalculateViscousForces, n_groups, &push);
-        ComputeToComputePipelineBarrier(cmd);
+        ComputeNeighborKernel(graph, KernelCalculateViscousForces, KernelCalculateViscousForcesTiled,
+                              &push, {b.position_buffer, b.velocity_buffer, b.density_buffer},
+                              {b.accel_buffer});
 
-        pipeline.Compute(cmd, KernelUpdatePositions, n_groups, &push);
+        DispatchUpdate(graph, KernelUpdatePositions, i, {},
+                       {b.accel_buffer, b.position_buffer, b.velocity_buffer});
     }
 }
 
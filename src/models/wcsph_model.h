@@ -21,9 +21,11 @@ public:
                const Parameters* parameters = nullptr);
 
     void Init(const gfx::CoreCtx& ctx) override;
-    void Step(const gfx::CoreCtx& ctx, VkCommandBuffer cmd) override;
     void DrawDebugUI() override;
 
+protected:
+    void RecordStep(const gfx::CoreCtx& ctx, ComputeGraph& graph) override;
+
 private:
     u32 parameter_id{0};
     Parameters parameters;
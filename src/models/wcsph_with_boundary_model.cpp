@@ -14,26 +14,46 @@ enum SimKernel : u32 {
     KernelCalculateDensities,
     KernelCalculatePressureAccel,
     KernelCalculateViscousAccel,
+    KernelBuildNeighborList,
+    KernelFusedDensity,
+    KernelFusedAccelUpdate,
+    KernelCommitIntegration,
+    KernelViscositySource,
+    KernelViscosityProduct,
+    KernelApplyViscosity,
 };
 
 struct VolumeMapBuffers {
     VkDeviceAddress boundary_density;
     VkDeviceAddress boundary_gradient;
+    VkDeviceAddress next_positions;
+    VkDeviceAddress next_velocities;
+};
+
+struct ViscosityBuffers {
+    VkDeviceAddress viscous_accel;
+    VkDeviceAddress solution;
+    VkDeviceAddress rhs;
+    VkDeviceAddress direction;
+    VkDeviceAddress product;
 };
 
 WCSPHWithBoundaryModel::WCSPHWithBoundaryModel(const SPHModel::Parameters* base_par,
-                                               const Parameters* par)
+                                               const Parameters* par,
+                                               const ViscositySolver* viscosity)
     : SPHModel(base_par) {
     if (par) {
         parameters = *par;
     } else {
         parameters = {
-            .wall_stiffness = 1e4,
             .stiffness = 1000,
             .expoent = 7,
             .viscosity_strenght = 0.01,
         };
     }
+
+    if (viscosity)
+        viscosity_solver = *viscosity;
 }
 
 void WCSPHWithBoundaryModel::Init(const gfx::CoreCtx& ctx) {
@@ -41,12 +61,19 @@ void WCSPHWithBoundaryModel::Init(const gfx::CoreCtx& ctx) {
 
     boundary_density = CreateDataBuffer<float>(ctx, SPHModel::parameters.n_particles);
     boundary_gradient = CreateDataBuffer<glm::vec3>(ctx, SPHModel::parameters.n_particles);
+    next_positions = CreateDataBuffer<glm::vec3>(ctx, SPHModel::parameters.n_particles);
+    next_velocities = CreateDataBuffer<glm::vec3>(ctx, SPHModel::parameters.n_particles);
+    viscous_accel = CreateDataBuffer<glm::vec3>(ctx, SPHModel::parameters.n_particles);
+    viscosity_cg.Init(ctx, SPHModel::parameters.n_particles, {.components = 3});
 
+    AddBufferToBeReordered(viscous_accel);
     InitBufferReorder(ctx);
 
     auto& sim = Simulation::Get();
     parameter_id = sim.AddUniformDescriptor(ctx, sizeof(Parameters));
     vm_buf_id = sim.AddUniformDescriptor(ctx, sizeof(VolumeMapBuffers));
+    viscosity_buf_id = sim.AddUniformDescriptor(ctx, sizeof(ViscosityBuffers));
+    AddBoundaryGridDescriptor();
 
     sim.InitDescriptorManager(ctx);
 
@@ -55,10 +82,22 @@ void WCSPHWithBoundaryModel::Init(const gfx::CoreCtx& ctx) {
     auto volume_map_bufs = VolumeMapBuffers{
         .boundary_density = boundary_density.device_addr,
         .boundary_gradient = boundary_gradient.device_addr,
+        .next_positions = next_positions.device_addr,
+        .next_velocities = next_velocities.device_addr,
     };
 
     sim.GetDescManager().SetUniformData(vm_buf_id, &volume_map_bufs);
 
+    auto viscosity_bufs = ViscosityBuffers{
+        .viscous_accel = viscous_accel.device_addr,
+        .solution = viscosity_cg.Solution().device_addr,
+        .rhs = viscosity_cg.RightHandSide().device_addr,
+        .direction = viscosity_cg.Direction().device_addr,
+        .product = viscosity_cg.Product().device_addr,
+    };
+
+    sim.GetDescManager().SetUniformData(viscosity_buf_id, &viscosity_bufs);
+
     pipeline.Init(ctx, {
                            .push_const_size = sizeof(SPHModel::PushConstants),
                            .set = sim.GetDescManager().Set(),
@@ -72,58 +111,147 @@ void WCSPHWithBoundaryModel::Init(const gfx::CoreCtx& ctx) {
                                    "CalculateDensities",
                                    "CalculatePressureAccel",
                                    "CalculateViscousAccel",
+                                   "BuildNeighborList",
+                                   "FusedDensity",
+                                   "FusedAccelUpdate",
+                                   "CommitIntegration",
+                                   "ViscositySource",
+                                   "ViscosityProduct",
+                                   "ApplyViscosity",
                                },
+                           .constants = SpecializationConstants(),
                        });
 
+    InitNeighborList(ctx, KernelBuildNeighborList);
     UpdateAllUniforms();
 }
 
-void WCSPHWithBoundaryModel::Step(const gfx::CoreCtx& ctx, VkCommandBuffer cmd) {
-    SPHModel::Step(ctx, cmd);
-
-    auto push = PushConstants{
-        .time = Platform::Info::GetTime(),
-        .dt = SPHModel::parameters.time_scale * SPHModel::parameters.fixed_dt /
-              (float)SPHModel::parameters.iterations,
-        .n_particles = (uint32_t)SPHModel::parameters.n_particles,
-    };
+void WCSPHWithBoundaryModel::RecordStep(const gfx::CoreCtx& ctx, ComputeGraph& graph) {
+    auto push = StepPushConstants();
 
     auto n_groups = glm::ivec3(SPHModel::parameters.n_particles / group_size + 1, 1, 1);
 
+    const auto& b = buffers;
+
     for (int i = 0; i < SPHModel::parameters.iterations; i++) {
-        if (i > 0)
-            ComputeToComputePipelineBarrier(cmd);
+        // The fused kernels only have the explicit viscosity
+        if (use_fused_kernels && !viscosity_solver.implicit) {
+            RunSpatialHash(graph, ctx);
+            RecordFusedSubstep(graph, i);
+            continue;
+        }
 
-        pipeline.Compute(cmd, KernelExternalAccel, n_groups, &push);
-        ComputeToComputePipelineBarrier(cmd);
+        graph.Dispatch(pipeline, KernelExternalAccel, n_groups, &push,
+                       {b.position_buffer, b.velocity_buffer}, {b.accel_buffer});
 
-        RunSpatialHash(cmd, ctx);
-        ComputeToComputePipelineBarrier(cmd);
+        RunSpatialHash(graph, ctx);
 
-        pipeline.Compute(cmd, KernelCalculateBoundaryVolume, n_groups, &push);
-        ComputeToComputePipelineBarrier(cmd);
+        graph.Dispatch(pipeline, KernelCalculateBoundaryVolume, n_groups, &push,
+                       {b.position_buffer}, {boundary_density, boundary_gradient});
 
-        pipeline.Compute(cmd, KernelCalculateDensities, n_groups, &push);
-        ComputeToComputePipelineBarrier(cmd);
+        graph.Dispatch(pipeline, KernelCalculateDensities, n_groups, &push,
+                       NeighborReads({b.position_buffer, boundary_density, boundary_gradient}),
+                       {b.density_buffer});
 
-        pipeline.Compute(cmd, KernelCalculatePressureAccel, n_groups, &push);
-        ComputeToComputePipelineBarrier(cmd);
+        graph.Dispatch(pipeline, KernelCalculatePressureAccel, n_groups, &push,
+                       NeighborReads({b.position_buffer, b.density_buffer, boundary_density,
+                                      boundary_gradient}),
+                       {b.accel_buffer});
 
-        pipeline.Compute(cmd, KernelCalculateViscousAccel, n_groups, &push);
-        ComputeToComputePipelineBarrier(cmd);
+        if (viscosity_solver.implicit) {
+            RecordImplicitViscosity(graph);
+        } else {
+            graph.Dispatch(pipeline, KernelCalculateViscousAccel, n_groups, &push,
+                           NeighborReads({b.position_buffer, b.velocity_buffer, b.density_buffer,
+                                          boundary_density, boundary_gradient}),
+                           {b.accel_buffer});
+        }
 
-        pipeline.Compute(cmd, KernelUpdatePositions, n_groups, &push);
+        DispatchUpdate(graph, KernelUpdatePositions, i, {},
+                       {b.accel_buffer, b.position_buffer, b.velocity_buffer});
     }
 }
 
+void WCSPHWithBoundaryModel::RecordFusedSubstep(ComputeGraph& graph, int iteration) {
+    auto push = StepPushConstants();
+
+    auto n_groups = glm::ivec3(SPHModel::parameters.n_particles / group_size + 1, 1, 1);
+
+    const auto& b = buffers;
+
+    graph.Dispatch(pipeline, KernelFusedDensity, n_groups, &push,
+                   NeighborReads({b.position_buffer}), {b.density_buffer, boundary_gradient});
+
+    DispatchUpdate(
+        graph, KernelFusedAccelUpdate, iteration,
+        NeighborReads({b.position_buffer, b.velocity_buffer, b.density_buffer, boundary_gradient}),
+        {next_positions, next_velocities});
+
+    graph.Dispatch(pipeline, KernelCommitIntegration, n_groups, &push,
+                   {next_positions, next_velocities}, {b.position_buffer, b.velocity_buffer});
+}
+
+void WCSPHWithBoundaryModel::RecordImplicitViscosity(ComputeGraph& graph) {
+    auto push = StepPushConstants();
+
+    auto n_groups = glm::ivec3(SPHModel::parameters.n_particles / group_size + 1, 1, 1);
+
+    const auto& b = buffers;
+    const auto& cg = viscosity_cg;
+
+    graph.Dispatch(pipeline, KernelViscositySource, n_groups, &push,
+                   {b.velocity_buffer, b.accel_buffer, viscous_accel},
+                   {cg.RightHandSide(), cg.Solution()});
+
+    graph.BeginScope("Viscosity solve");
+    viscosity_cg.Solve(graph, viscosity_solver.solver, [&](ComputeGraph& g) {
+        g.Dispatch(pipeline, KernelViscosityProduct, n_groups, &push,
+                   NeighborReads({b.position_buffer, b.density_buffer, cg.Direction()}),
+                   {cg.Product()});
+    });
+    graph.EndScope();
+
+    graph.Dispatch(pipeline, KernelApplyViscosity, n_groups, &push,
+                   {cg.Solution(), cg.RightHandSide()}, {b.accel_buffer, viscous_accel});
+}
+
+std::vector<ComputePipeline::SpecializationConstant>
+WCSPHWithBoundaryModel::SpecializationConstants() const {
+    auto constants = SPHModel::SpecializationConstants();
+
+    // Fixed by the scene, so the boundary handling is compiled out when there are no objects
+    if (specialize_parameters)
+        constants.push_back({.id = 2, .value = parameters.n_boundary_objects});
+
+    return constants;
+}
+
+void WCSPHWithBoundaryModel::Clear(const gfx::CoreCtx& ctx) {
+    SPHModel::Clear(ctx);
+
+    boundary_density.Destroy();
+    boundary_gradient.Destroy();
+    next_positions.Destroy();
+    next_velocities.Destroy();
+    viscous_accel.Destroy();
+    viscosity_cg.Clear(ctx);
+}
+
+std::vector<SPHModel::SolverStats> WCSPHWithBoundaryModel::LastSolverStats() const {
+    if (!viscosity_solver.implicit)
+        return {};
+
+    return {{"Viscosity", viscosity_cg.LastStats()}};
+}
+
 void WCSPHWithBoundaryModel::DrawDebugUI() {
     SPHModel::DrawDebugUI();
 
     auto& sim = Simulation::Get();
 
     if (ImGui::CollapsingHeader("WCSPH model")) {
-        if (ImGui::DragFloat("Wall stiffness", &parameters.wall_stiffness, 1e2, 0.0f, 1e6)) {
-            sim.GetDescManager().SetUniformData(parameter_id, &parameters);
+        if (ImGui::Checkbox("Fused kernels", &use_fused_kernels)) {
+            InvalidateStepCommands();
         }
 
         if (ImGui::SliderFloat("Stiffness", &parameters.stiffness, 0.0f, 5000.0f)) {
@@ -134,9 +262,17 @@ void WCSPHWithBoundaryModel::DrawDebugUI() {
             sim.GetDescManager().SetUniformData(parameter_id, &parameters);
         }
 
-        if (ImGui::DragFloat("Viscosity", &parameters.viscosity_strenght, 0.001f, 0.0f, 1.0f)) {
+        if (ImGui::DragFloat("Viscosity", &parameters.viscosity_strenght, 0.001f, 0.0f, 100.0f,
+                             "%.3f", ImGuiSliderFlags_Logarithmic)) {
             sim.GetDescManager().SetUniformData(parameter_id, &parameters);
         }
+
+        auto changed = ImGui::Checkbox("Implicit viscosity", &viscosity_solver.implicit);
+        if (viscosity_solver.implicit)
+            changed |= viscosity_cg.DrawUI("Viscosity", viscosity_solver.solver, 100.0f);
+
+        if (changed)
+            InvalidateStepCommands();
     }
 }
 }  // namespace vfs
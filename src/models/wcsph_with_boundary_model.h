@@ -2,9 +2,12 @@
 
 #include <glm/fwd.hpp>
 
+#include "compute/conjugate_gradient.h"
 #include "gfx/common.h"
 #include "gfx/mesh.h"
 #include "models/model.h"
+#include "models/volume_map_boundary.h"
+
 namespace vfs {
 /*
  * This model is based on the work by M. Becker and M. Teschner, “Weakly compressible SPH for free
@@ -13,31 +16,40 @@ namespace vfs {
  */
 class WCSPHWithBoundaryModel final : public SPHModel {
 public:
-    struct BoundaryObjectInfo {
-        glm::mat4x4 transform;
-        glm::mat4x4 rotation;
-        gfx::BoundingBox box;
-
-        VkDeviceAddress sdf_grid;
-        VkDeviceAddress volume_map_grid;
-        glm::uvec3 resolution;
-    };
-
+    // The walls of the bounding box are an inverted volume map, like the boundary objects
     struct Parameters {
-        float wall_stiffness;
         float stiffness;
         float expoent;
         float viscosity_strenght;
         VkDeviceAddress boundary_objects{0};
         u32 n_boundary_objects{0};
+        VkDeviceAddress boundary_candidates{0};
+    };
+
+    // Implicit viscosity as in M. Weiler, D. Koschier, M. Brand and J. Bender, “A physically
+    // consistent implicit viscosity solver for SPH fluids,” Computer Graphics Forum, vol. 37,
+    // no. 2, pp. 145–155, 2018. The explicit term limits the time step at high viscosities.
+    struct ViscositySolver {
+        bool implicit{false};
+        // Average residual, relative to the velocity of the particle
+        GPUConjugateGradient::Config solver{
+            .tolerance = 1e-2f, .min_iterations = 1, .max_iterations = 100};
     };
 
     WCSPHWithBoundaryModel(const SPHModel::Parameters* sph_parameters = nullptr,
-                           const Parameters* parameters = nullptr);
+                           const Parameters* parameters = nullptr,
+                           const ViscositySolver* viscosity_solver = nullptr);
 
     void Init(const gfx::CoreCtx& ctx) override;
-    void Step(const gfx::CoreCtx& ctx, VkCommandBuffer cmd) override;
+    void Clear(const gfx::CoreCtx& ctx) override;
     void DrawDebugUI() override;
+    std::vector<SolverStats> LastSolverStats() const override;
+    // Ignored with implicit viscosity, which needs the separate passes
+    void SetFusedKernels(bool fused) { use_fused_kernels = fused; }
+
+protected:
+    void RecordStep(const gfx::CoreCtx& ctx, ComputeGraph& graph) override;
+    std::vector<ComputePipeline::SpecializationConstant> SpecializationConstants() const override;
 
 private:
     u32 parameter_id{0};
@@ -46,6 +58,20 @@ private:
     u32 vm_buf_id{0};
     gfx::Buffer boundary_density;
     gfx::Buffer boundary_gradient;
+
+    // Two-pass substep (density, then acceleration and integration) instead of six dispatches
+    bool use_fused_kernels{false};
+    gfx::Buffer next_positions;
+    gfx::Buffer next_velocities;
+
+    ViscositySolver viscosity_solver;
+    u32 viscosity_buf_id{0};
+    GPUConjugateGradient viscosity_cg;
+    // Viscous acceleration of the last substep, the initial guess of the next solve
+    gfx::Buffer viscous_accel;
+
+    void RecordFusedSubstep(ComputeGraph& graph, int iteration);
+    void RecordImplicitViscosity(ComputeGraph& graph);
 };
 
 }  // namespace vfs
@@ -32,7 +32,7 @@ void ParticleDrawPipeline::Init(const gfx::CoreCtx& ctx, VkFormat draw_img_forma
             .SetDepthTestDisabled()
             .SetBlendingAlphaBlend()  // Check if this is OK
             .SetColorAttachmentFormat(draw_img_format)
-            .Build(ctx.device);
+            .Build(ctx.device, ctx.pipeline_cache);
 
     vkDestroyShaderModule(ctx.device, gfx_shader, nullptr);
 }
@@ -107,7 +107,7 @@ void Particle3DDrawPipeline::Init(const gfx::CoreCtx& ctx,
             .SetDepthTest(true, VK_COMPARE_OP_LESS_OR_EQUAL)
             .SetBlendingAlphaBlend()  // Check if this is OK
             .SetColorAttachmentFormat(draw_img_format)
-            .Build(ctx.device);
+            .Build(ctx.device, ctx.pipeline_cache);
 
     vkDestroyShaderModule(ctx.device, gfx_shader, nullptr);
 }
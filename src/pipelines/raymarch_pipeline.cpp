@@ -39,7 +39,7 @@ void DensityRaymarchDrawPipeline::Init(const gfx::CoreCtx& ctx,
             .SetDepthTest(true, VK_COMPARE_OP_LESS_OR_EQUAL)
             .SetBlendingAlphaBlend()  // Check if this is OK
             .SetColorAttachmentFormat(draw_img_format)
-            .Build(ctx.device);
+            .Build(ctx.device, ctx.pipeline_cache);
 
     vkDestroyShaderModule(ctx.device, gfx_shader, nullptr);
 }
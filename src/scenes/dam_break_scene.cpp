@@ -18,12 +18,15 @@ void DamBreakScene::Init() {
     };
 
     time_step_model = std::make_unique<LagueModel>(&base_parameters);
+    // Builds the cell tiles so that the tiled kernels can be turned on from the UI, the
+    // per-particle kernels run by default
+    time_step_model->SetSpatialHashConfig({.cell_tiles = true});
 
     time_step_model->Init(gfx.GetCoreCtx());
     Reset();
 }
-void DamBreakScene::Step(VkCommandBuffer cmd) {
-    time_step_model->Step(gfx.GetCoreCtx(), cmd);
+void DamBreakScene::Step(VkCommandBuffer cmd, u32 count) {
+    time_step_model->Step(gfx.GetCoreCtx(), cmd, count);
 }
 
 void DamBreakScene::Clear() {
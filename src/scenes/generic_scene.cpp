@@ -1,29 +1,51 @@
 #include "generic_scene.h"
 
+#include <algorithm>
+#include <glm/gtc/packing.hpp>
+
+#include "imgui.h"
 #include "platform.h"
 #include "simulation.h"
+#include "util/heightmap.h"
 #include "util/mesh_loader.h"
+#include "util/primitive_mesh.h"
 #include "util/volume_map.h"
 
 namespace vfs {
 
+namespace {
+// Distances of the volume table of a round primitive, from its surface to the smoothing radius
+constexpr u32 PRIMITIVE_VOLUME_SAMPLES = 32;
+}  // namespace
+
 GenericScene::GenericScene(gfx::Device& gfx,
                            const SPHModel::Parameters& base_parameters,
-                           const WCSPHWithBoundaryModel::Parameters& model_parameters,
+                           const ModelDef& model,
+                           const SpatialHash::Config& spatial_hash_config,
                            const std::vector<FluidBlock>& fluid_blocks,
                            const std::vector<ObjectDef>& boundary_objects)
     : SceneBase(gfx) {
     this->base_parameters = base_parameters;
-    this->model_parameters = model_parameters;
+    this->model = model;
+    this->spatial_hash_config = spatial_hash_config;
     this->fluid_blocks = fluid_blocks;
     this->boundary_object_def = boundary_objects;
 }
 void GenericScene::Init() {
     for (const auto& obj : boundary_object_def) {
-        AddBoundaryObject(Platform::Info::ResourcePath(obj.path.c_str()), obj.transform,
-                          obj.resolution);
+        if (obj.shape == BoundaryShape::Mesh) {
+            AddBoundaryObject(Platform::Info::ResourcePath(obj.path.c_str()), obj.transform,
+                              obj.resolution);
+        } else if (obj.shape == BoundaryShape::Heightfield) {
+            AddHeightfieldObject(Platform::Info::ResourcePath(obj.path.c_str()),
+                                 glm::uvec2(obj.resolution), obj.size, obj.transform);
+        } else {
+            AddPrimitiveObject(obj.shape, obj.size, obj.transform);
+        }
     }
+    CreateBoundaryGridTexture();
     CreateBoundaryObjectBuffer();
+    BuildBoundaryBroadphase();
 
     u32 total_n_particles{0};
     for (const auto& block : fluid_blocks) {
@@ -31,14 +53,60 @@ void GenericScene::Init() {
     }
 
     base_parameters.n_particles = total_n_particles;
-    model_parameters.n_boundary_objects = boundary_objects.size();
-    model_parameters.boundary_objects = boundary_objects_gpu_buffer.device_addr;
 
-    time_step_model = std::make_unique<WCSPHWithBoundaryModel>(&base_parameters, &model_parameters);
+    time_step_model = CreateModel();
+    time_step_model->SetBoundaryGridTexture({
+        .image = boundary_grid_texture,
+        .sampler = boundary_grid_sampler,
+        .layout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+    });
+    time_step_model->SetSpatialHashConfig(spatial_hash_config);
+    time_step_model->SetAdaptiveTimeStep(model.adaptive_time_step);
     time_step_model->Init(gfx.GetCoreCtx());
 
     Reset();
 }
+std::unique_ptr<SPHModel> GenericScene::CreateModel() {
+    const auto objects = boundary_objects_gpu_buffer.device_addr;
+    const auto n_objects = (u32)boundary_objects.size();
+    const auto candidates = boundary_broadphase.CandidatesAddr();
+
+    switch (model.type) {
+    case FluidModel::DFSPH:
+        model.dfsph.boundary_objects = objects;
+        model.dfsph.n_boundary_objects = n_objects;
+        model.dfsph.boundary_candidates = candidates;
+        return std::make_unique<DFSPHModel>(&base_parameters, &model.dfsph, &model.dfsph_solver);
+
+    case FluidModel::IISPH:
+        model.iisph.boundary_objects = objects;
+        model.iisph.n_boundary_objects = n_objects;
+        model.iisph.boundary_candidates = candidates;
+        return std::make_unique<IISPHModel>(&base_parameters, &model.iisph, &model.iisph_solver);
+
+    case FluidModel::PBF:
+        model.pbf.boundary_objects = objects;
+        model.pbf.n_boundary_objects = n_objects;
+        model.pbf.boundary_candidates = candidates;
+        return std::make_unique<PBFModel>(&base_parameters, &model.pbf);
+
+    case FluidModel::FLIP:
+        model.flip.boundary_objects = objects;
+        model.flip.n_boundary_objects = n_objects;
+        model.flip.boundary_candidates = candidates;
+        return std::make_unique<FLIPModel>(&base_parameters, &model.flip, &model.flip_solver);
+
+    case FluidModel::WCSPH:
+    default:
+        model.wcsph.boundary_objects = objects;
+        model.wcsph.n_boundary_objects = n_objects;
+        model.wcsph.boundary_candidates = candidates;
+        auto wcsph = std::make_unique<WCSPHWithBoundaryModel>(&base_parameters, &model.wcsph,
+                                                               &model.wcsph_viscosity);
+        wcsph->SetFusedKernels(model.wcsph_fused_kernels);
+        return wcsph;
+    }
+}
 void GenericScene::Reset() {
     const auto box = time_step_model->GetBoundingBox().value();
     const auto n_particles = time_step_model->GetParameters().n_particles;
@@ -55,13 +123,18 @@ void GenericScene::Reset() {
         offset += count;
     }
 }
-void GenericScene::Step(VkCommandBuffer cmd) {
-    time_step_model->Step(gfx.GetCoreCtx(), cmd);
+void GenericScene::Step(VkCommandBuffer cmd, u32 count) {
+    time_step_model->Step(gfx.GetCoreCtx(), cmd, count);
 }
 void GenericScene::Clear() {
     time_step_model->Clear(gfx.GetCoreCtx());
 
     boundary_objects_gpu_buffer.Destroy();
+    boundary_broadphase.Clear(gfx.GetCoreCtx());
+    boundary_grid_texture.Destroy();
+    if (boundary_grid_sampler)
+        vkDestroySampler(gfx.GetCoreCtx().device, boundary_grid_sampler, nullptr);
+    boundary_grid_sampler = VK_NULL_HANDLE;
     for (auto& b : boundary_objects) {
         b.gpu_mesh.vertices.Destroy();
         b.gpu_mesh.indices.Destroy();
@@ -122,29 +195,212 @@ void GenericScene::AddBoundaryObject(const std::string& path,
 
     boundary_objects.push_back(obj);
 }
+void GenericScene::AddPrimitiveObject(BoundaryShape shape,
+                                      const glm::vec3& size,
+                                      const gfx::Transform& transform) {
+    VolumeMapBoundaryObject obj;
+
+    obj.shape = shape;
+    obj.size = size;
+    obj.transform = transform;
+    obj.transform.SetScale(glm::vec3(1.0f));
+
+    // Planes are drawn across the whole domain
+    const auto extent = 2.0f * glm::length(base_parameters.bounding_box.size);
+    obj.mesh = CreatePrimitiveMesh(shape, size, extent);
+    obj.gpu_mesh = gfx::UploadMesh(gfx, obj.mesh);
+
+    // The flat wall volume is exact for boxes and planes, the round shapes sample a table of the
+    // volume against the distance
+    if (shape == BoundaryShape::Sphere || shape == BoundaryShape::Capsule ||
+        shape == BoundaryShape::Cylinder) {
+        const auto h = Simulation::Get().GetGlobalParameters().smooth_radius;
+        const auto table = GeneratePrimitiveVolumeTable(shape, size, h, PRIMITIVE_VOLUME_SAMPLES);
+
+        obj.resolution = glm::uvec3(PRIMITIVE_VOLUME_SAMPLES, 1, 1);
+        obj.volume_map_gpu_grid = gfx::CreateDataBuffer<float>(gfx.GetCoreCtx(), table.size());
+        gfx.SetDataVec(obj.volume_map_gpu_grid, table);
+    }
+
+    boundary_objects.push_back(obj);
+}
+void GenericScene::AddHeightfieldObject(const std::string& path,
+                                        const glm::uvec2 raw_resolution,
+                                        const glm::vec3& size,
+                                        const gfx::Transform& transform) {
+    auto heightmap = LoadHeightmap(path, raw_resolution);
+    if (!heightmap)
+        return;
+
+    VolumeMapBoundaryObject obj;
+
+    obj.shape = BoundaryShape::Heightfield;
+    obj.size = size;
+    obj.transform = transform;
+    obj.transform.SetScale(glm::vec3(1.0f));
+    obj.box = {.size = size, .pos = glm::vec3(0.0f)};
+    obj.resolution = glm::uvec3(heightmap->resolution.x, 1, heightmap->resolution.y);
+
+    obj.mesh = CreateHeightfieldMesh(*heightmap, size);
+    obj.gpu_mesh = gfx::UploadMesh(gfx, obj.mesh);
+
+    // Only the heights are stored, the volume is computed from the distance to the surface
+    obj.sdf_gpu_grid = gfx::CreateDataBuffer<float>(gfx.GetCoreCtx(), heightmap->heights.size());
+    gfx.SetDataVec(obj.sdf_gpu_grid, heightmap->heights);
+
+    boundary_objects.push_back(obj);
+}
+void GenericScene::CreateBoundaryGridTexture() {
+    const auto& ctx = gfx.GetCoreCtx();
+
+    VkPhysicalDeviceProperties props;
+    vkGetPhysicalDeviceProperties(ctx.chosen_gpu, &props);
+    const auto max_side = props.limits.maxImageDimension3D;
+
+    // The mesh grids are stacked along z, the ones that do not fit keep sampling their buffers.
+    // Without filtering nothing is packed. Every side has at least two texels so that the image is
+    // always 3D, also when it is only bound.
+    auto extent = glm::uvec3(2, 2, 0);
+    for (auto& b : boundary_objects) {
+        b.in_grid_texture = false;
+        if (b.shape != BoundaryShape::Mesh || !filter_boundary_grids)
+            continue;
+
+        const auto n = b.sdf.GetResolution();
+        if (glm::any(glm::greaterThan(n, glm::uvec3(max_side))) || extent.z + n.z > max_side) {
+            fmt::println("The grids of {} do not fit in the grid texture, sampling the buffers",
+                         b.mesh.name);
+            continue;
+        }
+
+        b.in_grid_texture = true;
+        b.texture_layer = extent.z;
+        extent = glm::uvec3(glm::max(glm::uvec2(extent), glm::uvec2(n)), extent.z + n.z);
+    }
+    extent.z = std::max(extent.z, 2u);
+
+    // Linear filtering of 32-bit floats is optional, half floats always support it
+    VkFormatProperties props;
+    vkGetPhysicalDeviceFormatProperties(ctx.chosen_gpu, VK_FORMAT_R32G32_SFLOAT, &props);
+    boundary_grid_half = !(props.optimalTilingFeatures &
+                           VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT);
+
+    const auto n_texels = extent.x * extent.y * extent.z;
+    auto texels = std::vector<glm::vec2>(n_texels, glm::vec2(0.0f));
+
+    for (const auto& b : boundary_objects) {
+        if (!b.in_grid_texture)
+            continue;
+
+        const auto n = b.sdf.GetResolution();
+        const auto& sdf = b.sdf.GetSDF();
+        const auto& volume = b.volume_map.GetGrid();
+
+        for (u32 k = 0; k < n.z; k++) {
+            for (u32 j = 0; j < n.y; j++) {
+                for (u32 i = 0; i < n.x; i++) {
+                    const auto src = i + n.x * (j + n.y * k);
+                    const auto dst = i + extent.x * (j + extent.y * (b.texture_layer + k));
+                    texels[dst] = glm::vec2((f32)sdf[src], (f32)volume[src]);
+                }
+            }
+        }
+    }
+
+    const auto format = boundary_grid_half ? VK_FORMAT_R16G16_SFLOAT : VK_FORMAT_R32G32_SFLOAT;
+    boundary_grid_texture = gfx::Image::Create(
+        ctx, {.width = extent.x, .height = extent.y, .depth = extent.z}, format,
+        VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT);
+
+    if (boundary_grid_half) {
+        auto packed = std::vector<u32>(n_texels);
+        for (u32 i = 0; i < n_texels; i++) {
+            packed[i] = glm::packHalf2x16(texels[i]);
+        }
+        gfx.SetImageData(boundary_grid_texture, packed.data(), sizeof(u32));
+    } else {
+        gfx.SetImageData(boundary_grid_texture, texels.data(), sizeof(glm::vec2));
+    }
+
+    auto sampler_info = VkSamplerCreateInfo{
+        .sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO,
+        .magFilter = VK_FILTER_LINEAR,
+        .minFilter = VK_FILTER_LINEAR,
+        .addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+        .addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+        .addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+    };
+    VK_CHECK(vkCreateSampler(ctx.device, &sampler_info, nullptr, &boundary_grid_sampler));
+}
 void GenericScene::CreateBoundaryObjectBuffer() {
     if (boundary_objects.empty())
         return;
 
-    boundary_objects_gpu_buffer = gfx::CreateDataBuffer<WCSPHWithBoundaryModel::BoundaryObjectInfo>(
-        gfx.GetCoreCtx(), boundary_objects.size());
+    boundary_objects_gpu_buffer =
+        gfx::CreateDataBuffer<BoundaryObjectInfo>(gfx.GetCoreCtx(), boundary_objects.size());
+
+    UploadBoundaryObjects();
+}
+void GenericScene::UploadBoundaryObjects() {
+    const auto extent = boundary_grid_texture.extent;
+    const auto texture_scale =
+        1.0f / glm::vec3((f32)extent.width, (f32)extent.height, (f32)extent.depth);
 
-    auto objs = std::vector<WCSPHWithBoundaryModel::BoundaryObjectInfo>();
+    auto objs = std::vector<BoundaryObjectInfo>();
     for (const auto& b : boundary_objects) {
+        const auto filtered = b.in_grid_texture && filter_boundary_grids;
+
         objs.push_back({
             .transform = glm::inverse(b.transform.Matrix()),
             .rotation = glm::mat4_cast(b.transform.Rotation()),
-            .box = b.sdf.GetBox(),
+            .box = b.shape == BoundaryShape::Mesh ? b.sdf.GetBox() : b.box,
             .sdf_grid = b.sdf_gpu_grid.device_addr,
             .volume_map_grid = b.volume_map_gpu_grid.device_addr,
-            .resolution = b.sdf.GetResolution(),
+            .resolution = b.shape == BoundaryShape::Mesh ? b.sdf.GetResolution() : b.resolution,
+            .shape = b.shape,
+            .size = b.size,
+            // Texel centers are at half-integer coordinates
+            .texture_offset = glm::vec3(0.5f, 0.5f, (f32)b.texture_layer + 0.5f),
+            .texture_scale = filtered ? texture_scale : glm::vec3(0.0f),
         });
     }
 
     gfx.SetDataVec(boundary_objects_gpu_buffer, objs);
 }
+void GenericScene::BuildBoundaryBroadphase() {
+    if (boundary_objects.empty())
+        return;
+
+    // Cells of at least two smoothing radii, and at most 64 along the longest side of the box
+    const auto h = Simulation::Get().GetGlobalParameters().smooth_radius;
+    const auto& box = base_parameters.bounding_box;
+    const auto cell_size = std::max(2.0f * h, glm::compMax(box.size) / 64.0f);
+
+    boundary_broadphase.Init(gfx, box, {.cell_size = cell_size});
+
+    // The objects do not move, so the candidates are built once
+    gfx.ImmediateSubmit([&](VkCommandBuffer cmd) {
+        ComputeGraph graph(cmd);
+        boundary_broadphase.Build(graph, boundary_objects_gpu_buffer, h);
+    });
+}
 void GenericScene::DrawDebugUI() {
     SceneBase::DrawDebugUI();
+
+    if (!boundary_objects.empty() && ImGui::CollapsingHeader("Boundary objects")) {
+        // Compare through the kernel timings, e.g. of CalculateBoundaryVolume. Scenes loaded
+        // without filtering have no grids in the texture.
+        const auto packed = std::any_of(boundary_objects.begin(), boundary_objects.end(),
+                                        [](const auto& b) { return b.in_grid_texture; });
+        ImGui::BeginDisabled(!packed);
+        if (ImGui::Checkbox("Hardware-filtered mesh grids", &filter_boundary_grids))
+            UploadBoundaryObjects();
+        ImGui::EndDisabled();
+
+        ImGui::Text("Grid texture: %u x %u x %u, %s", boundary_grid_texture.extent.width,
+                    boundary_grid_texture.extent.height, boundary_grid_texture.extent.depth,
+                    boundary_grid_half ? "R16G16" : "R32G32");
+    }
 }
 void GenericScene::InitCustomDraw(VkFormat draw_img_fmt, VkFormat depth_img_format) {
     mesh_pipeline.Init(gfx.GetCoreCtx(), draw_img_fmt, depth_img_format);
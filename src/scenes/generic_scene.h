@@ -4,6 +4,12 @@
 #include <string>
 
 #include "gfx/transform.h"
+#include "models/boundary_broadphase.h"
+#include "models/dfsph_model.h"
+#include "models/flip_model.h"
+#include "models/iisph_model.h"
+#include "models/pbf_model.h"
+#include "models/volume_map_boundary.h"
 #include "models/wcsph_with_boundary_model.h"
 #include "pipelines/mesh_pipeline.h"
 #include "scenes/scene.h"
@@ -20,15 +26,41 @@ public:
         glm::vec3 pos;
     };
 
+    // Meshes are loaded from `path` and sampled on a grid of `resolution`. Heightfields are
+    // loaded from `path` too, and `resolution` is the one of RAW heightmaps. Primitives only use
+    // their size. The transform of primitives and heightfields has no scale.
     struct ObjectDef {
+        BoundaryShape shape{BoundaryShape::Mesh};
         std::string path;
         gfx::Transform transform;
-        glm::uvec3 resolution;
+        glm::uvec3 resolution{0};
+        glm::vec3 size{0.0f};
+    };
+
+    enum class FluidModel { WCSPH, DFSPH, IISPH, PBF, FLIP };
+
+    // Model selected by the scene and its parameters. The boundary objects are set by the scene.
+    struct ModelDef {
+        FluidModel type{FluidModel::WCSPH};
+        SPHModel::AdaptiveTimeStep adaptive_time_step{};
+        WCSPHWithBoundaryModel::Parameters wcsph{};
+        WCSPHWithBoundaryModel::ViscositySolver wcsph_viscosity{};
+        bool wcsph_fused_kernels{false};
+        DFSPHModel::Parameters dfsph{};
+        DFSPHModel::SolverConfig dfsph_solver{};
+        IISPHModel::Parameters iisph{};
+        IISPHModel::SolverConfig iisph_solver{
+            .tolerance = 1e-3f, .min_iterations = 2, .max_iterations = 50};
+        PBFModel::Parameters pbf{};
+        FLIPModel::Parameters flip{};
+        FLIPModel::SolverConfig flip_solver{
+            .tolerance = 1e-2f, .min_iterations = 1, .max_iterations = 100};
     };
 
     GenericScene(gfx::Device& gfx,
                  const SPHModel::Parameters& base_parameters,
-                 const WCSPHWithBoundaryModel::Parameters& model_parameters,
+                 const ModelDef& model,
+                 const SpatialHash::Config& spatial_hash_config,
                  const std::vector<FluidBlock>& fluid_blocks,
                  const std::vector<ObjectDef>& boundary_objects);
 
@@ -36,7 +68,10 @@ public:
 
     void Reset() override;
 
-    void Step(VkCommandBuffer cmd) override;
+    // Same as the "Hardware-filtered mesh grids" checkbox, set before Init
+    void SetFilterBoundaryGrids(bool filter) { filter_boundary_grids = filter; }
+
+    void Step(VkCommandBuffer cmd, u32 count) override;
 
     void Clear() override;
 
@@ -55,6 +90,14 @@ private:
         gfx::GPUMesh gpu_mesh;
         gfx::Transform transform;
         gfx::BoundingBox box;
+        BoundaryShape shape{BoundaryShape::Mesh};
+        glm::vec3 size{0.0f};
+        // Samples of the grids that are not built from the mesh: heights of a heightfield, or the
+        // volume table of a round primitive in resolution.x
+        glm::uvec3 resolution{0};
+        // First z texel of the mesh grids in the grid texture, when they fit in it
+        bool in_grid_texture{false};
+        u32 texture_layer{0};
 
         MeshSDF sdf;
         LinearLagrangeDiscreteGrid volume_map;
@@ -64,9 +107,18 @@ private:
 
     std::string name;
     SPHModel::Parameters base_parameters;
-    WCSPHWithBoundaryModel::Parameters model_parameters;
+    ModelDef model;
+    SpatialHash::Config spatial_hash_config;
 
     gfx::Buffer boundary_objects_gpu_buffer;
+    BoundaryBroadphase boundary_broadphase;
+
+    // Mesh grids of every object, distance and volume interleaved
+    gfx::Image boundary_grid_texture{};
+    VkSampler boundary_grid_sampler{VK_NULL_HANDLE};
+    bool boundary_grid_half{false};
+    // Off samples the grid buffers, for comparison
+    bool filter_boundary_grids{true};
     std::vector<VolumeMapBoundaryObject> boundary_objects;
 
     std::vector<ObjectDef> boundary_object_def;
@@ -77,7 +129,18 @@ private:
     void AddBoundaryObject(const std::string& path,
                            const gfx::Transform& transform,
                            const glm::uvec3 resolution);
-
+    void AddPrimitiveObject(BoundaryShape shape,
+                            const glm::vec3& size,
+                            const gfx::Transform& transform);
+    void AddHeightfieldObject(const std::string& path,
+                              const glm::uvec2 raw_resolution,
+                              const glm::vec3& size,
+                              const gfx::Transform& transform);
+
+    void CreateBoundaryGridTexture();
     void CreateBoundaryObjectBuffer();
+    void UploadBoundaryObjects();
+    void BuildBoundaryBroadphase();
+    std::unique_ptr<SPHModel> CreateModel();
 };
 }  // namespace vfs
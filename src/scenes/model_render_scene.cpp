@@ -90,7 +90,7 @@ void ModelRenderScene::Init() {
     // GenerateSDF();
 }
 
-void ModelRenderScene::Step(VkCommandBuffer cmd) {}
+void ModelRenderScene::Step(VkCommandBuffer cmd, u32 count) {}
 
 void ModelRenderScene::DrawDebugUI() {
     SceneBase::DrawDebugUI();
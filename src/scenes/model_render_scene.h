@@ -17,7 +17,7 @@ public:
     using SceneBase::SceneBase;
 
     void Init() override;
-    void Step(VkCommandBuffer) override;
+    void Step(VkCommandBuffer, u32 count) override;
     void Clear() override;
     void Reset() override;
 
@@ -16,7 +16,7 @@ public:
     SceneBase(gfx::Device& device) : gfx(device) {};
     virtual ~SceneBase() {}
     virtual void Init() = 0;
-    virtual void Step(VkCommandBuffer) = 0;
+    virtual void Step(VkCommandBuffer, u32 count) = 0;
     virtual void Clear() = 0;
     virtual void Reset() = 0;
 
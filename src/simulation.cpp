@@ -26,13 +26,34 @@ void Simulation::Init(const gfx::CoreCtx& ctx) {
     ClearDescManager(ctx);
 }
 
-void Simulation::Step(VkCommandBuffer cmd) {
-    if (scene) {
-        scene->Step(cmd);
-        current_step++;
+void Simulation::Step(VkCommandBuffer cmd, u32 count) {
+    if (scene && count > 0) {
+        scene->Step(cmd, count);
+        current_step += count;
     }
 }
 
+float Simulation::StepTime() const {
+    if (!scene || !scene->GetModel())
+        return 0.0f;
+
+    return scene->GetModel()->StepTime();
+}
+
+float Simulation::GetTime() const {
+    if (!scene || !scene->GetModel())
+        return 0.0f;
+
+    return scene->GetModel()->ElapsedTime();
+}
+
+void Simulation::ResetTime() {
+    if (scene && scene->GetModel())
+        scene->GetModel()->ResetTime();
+
+    current_step = 0;
+}
+
 void Simulation::Clear(const gfx::CoreCtx& ctx) {
     if (scene)
         scene->Clear();
@@ -54,6 +75,7 @@ void Simulation::SetScene(std::unique_ptr<SceneBase>&& s) {
         scene->Clear();
     scene = std::move(s);
     scene->Init();
+    ResetTime();
 };
 SceneBase* Simulation::GetScene() {
     return scene.get();
@@ -94,9 +116,21 @@ void Simulation::DrawDebugUI() {
                 GetDescManager().SetUniformData(global_parameter_id, &parameters);
             }
 
-            if (ImGui::DragFloat("Smooth radius", &parameters.smooth_radius, 0.01f, 0.0f, 50.0f)) {
+            // Applied when the edit ends, every value rebuilds the spatial hash and the models
+            // compile kernels specialized for it
+            auto radius = edited_smooth_radius.value_or(parameters.smooth_radius);
+            if (ImGui::DragFloat("Smooth radius", &radius, 0.01f, 0.0f, 50.0f)) {
+                edited_smooth_radius = radius;
+            }
+
+            if (ImGui::IsItemDeactivatedAfterEdit()) {
+                parameters.smooth_radius = radius;
                 GetDescManager().SetUniformData(global_parameter_id, &parameters);
             }
+
+            if (ImGui::IsItemDeactivated()) {
+                edited_smooth_radius.reset();
+            }
         }
 
         scene->DrawDebugUI();
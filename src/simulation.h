@@ -1,6 +1,7 @@
 #pragma once
 
 #include <memory>
+#include <optional>
 
 #include "gfx/descriptor.h"
 #include "scenes/scene.h"
@@ -19,7 +20,7 @@ public:
     friend SimulationBuilder;
 
     void Init(const gfx::CoreCtx& ctx);
-    void Step(VkCommandBuffer cmd);
+    void Step(VkCommandBuffer cmd, u32 count = 1);
     void Clear(const gfx::CoreCtx& ctx);
 
     static Simulation& Get();
@@ -29,6 +30,11 @@ public:
 
     void SetScene(std::unique_ptr<SceneBase>&& scene);
     SceneBase* GetScene();
+    // Simulated time advanced by one step, zero without a model
+    float StepTime() const;
+    float GetTime() const;
+    u32 GetStepCount() const { return current_step; }
+    void ResetTime();
     void DrawDebugUI();
 
     u32 AddUniformDescriptor(const gfx::CoreCtx& ctx, u32 size);
@@ -46,6 +52,8 @@ private:
     Simulation& operator=(Simulation&&) = delete;
 
     SimulationParameters parameters;
+    // Value being dragged in the UI, not yet applied
+    std::optional<float> edited_smooth_radius;
     std::unique_ptr<SceneBase> scene;
 
     u32 global_parameter_id;
@@ -53,7 +61,6 @@ private:
     gfx::DescriptorManager::DescriptorInfo global_parameter_info;
     std::vector<gfx::DescriptorManager::DescriptorInfo> descriptors;
 
-    float current_time{0.0f};
     u32 current_step{0};
 };
 }  // namespace vfs
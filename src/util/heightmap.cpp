@@ -0,0 +1,120 @@
+#include "heightmap.h"
+
+#include <cmath>
+#include <filesystem>
+#include <fstream>
+
+#define STB_IMAGE_IMPLEMENTATION
+#define STBI_ONLY_PNG
+#include <stb_image.h>
+
+namespace vfs {
+
+namespace {
+std::optional<Heightmap> LoadPNG(const std::string& path) {
+    int width = 0;
+    int height = 0;
+    int channels = 0;
+
+    auto* data = stbi_load_16(path.c_str(), &width, &height, &channels, 1);
+    if (!data) {
+        fmt::println("Could not load heightmap {}: {}", path, stbi_failure_reason());
+        return std::nullopt;
+    }
+
+    auto heightmap = Heightmap{.resolution = glm::uvec2(width, height)};
+    heightmap.heights.resize((size_t)width * height);
+    for (size_t i = 0; i < heightmap.heights.size(); i++) {
+        heightmap.heights[i] = (f32)data[i] / 65535.0f;
+    }
+
+    stbi_image_free(data);
+    return heightmap;
+}
+
+std::optional<Heightmap> LoadRaw(const std::string& path, glm::uvec2 resolution) {
+    auto file = std::ifstream(path, std::ios::binary | std::ios::ate);
+    if (!file) {
+        fmt::println("Could not open heightmap {}", path);
+        return std::nullopt;
+    }
+
+    const auto count = (size_t)file.tellg() / sizeof(u16);
+    if (resolution.x == 0 || resolution.y == 0) {
+        const auto side = (u32)std::lround(std::sqrt((double)count));
+        resolution = glm::uvec2(side);
+    }
+
+    if ((size_t)resolution.x * resolution.y != count) {
+        fmt::println("Heightmap {} has {} samples, expected {}x{}", path, count, resolution.x,
+                     resolution.y);
+        return std::nullopt;
+    }
+
+    auto samples = std::vector<u16>(count);
+    file.seekg(0);
+    file.read(reinterpret_cast<char*>(samples.data()), count * sizeof(u16));
+
+    auto heightmap = Heightmap{.resolution = resolution};
+    heightmap.heights.resize(count);
+    for (size_t i = 0; i < count; i++) {
+        heightmap.heights[i] = (f32)samples[i] / 65535.0f;
+    }
+
+    return heightmap;
+}
+}  // namespace
+
+std::optional<Heightmap> LoadHeightmap(const std::string& path, glm::uvec2 raw_resolution) {
+    const auto extension = std::filesystem::path(path).extension().string();
+
+    auto heightmap = extension == ".png" ? LoadPNG(path) : LoadRaw(path, raw_resolution);
+
+    if (heightmap && (heightmap->resolution.x < 2 || heightmap->resolution.y < 2)) {
+        fmt::println("Heightmap {} needs at least 2x2 samples", path);
+        return std::nullopt;
+    }
+
+    return heightmap;
+}
+
+gfx::CPUMesh CreateHeightfieldMesh(const Heightmap& heightmap, const glm::vec3& size) {
+    auto mesh = gfx::CPUMesh{.name = "Heightfield"};
+
+    const auto n = heightmap.resolution;
+    const auto spacing = glm::vec2(size.x, size.z) / glm::vec2(n - 1u);
+
+    auto height = [&](int x, int z) {
+        x = glm::clamp(x, 0, (int)n.x - 1);
+        z = glm::clamp(z, 0, (int)n.y - 1);
+        return size.y * heightmap.heights[x + (size_t)n.x * z];
+    };
+
+    for (int z = 0; z < (int)n.y; z++) {
+        for (int x = 0; x < (int)n.x; x++) {
+            const auto dx = (height(x + 1, z) - height(x - 1, z)) / (2.0f * spacing.x);
+            const auto dz = (height(x, z + 1) - height(x, z - 1)) / (2.0f * spacing.y);
+
+            mesh.vertices.push_back({
+                .pos = {x * spacing.x, height(x, z), z * spacing.y},
+                .uv = glm::vec2(x, z) / glm::vec2(n - 1u),
+                .normal = glm::normalize(glm::vec3(-dx, 1.0f, -dz)),
+            });
+        }
+    }
+
+    for (u32 z = 0; z + 1 < n.y; z++) {
+        for (u32 x = 0; x + 1 < n.x; x++) {
+            const auto a = x + n.x * z;
+            const auto b = a + n.x;
+
+            for (u32 idx : {a, b, a + 1, a + 1, b, b + 1}) {
+                mesh.indices.push_back(idx);
+            }
+        }
+    }
+
+    return mesh;
+}
+
+}  // namespace vfs
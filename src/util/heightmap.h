@@ -0,0 +1,25 @@
+#pragma once
+
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "gfx/common.h"
+#include "gfx/mesh.h"
+
+namespace vfs {
+
+// Heights in [0, 1], row-major with x along the rows and z across them
+struct Heightmap {
+    glm::uvec2 resolution{0};
+    std::vector<f32> heights;
+};
+
+// Loads a grayscale PNG (8 or 16 bits) or a little-endian 16-bit RAW file. RAW files have no
+// header, so their resolution is given, or taken as square when it is zero.
+std::optional<Heightmap> LoadHeightmap(const std::string& path, glm::uvec2 raw_resolution);
+
+// Surface over local x in [0, size.x] and z in [0, size.z], with heights scaled by size.y
+gfx::CPUMesh CreateHeightfieldMesh(const Heightmap& heightmap, const glm::vec3& size);
+
+}  // namespace vfs
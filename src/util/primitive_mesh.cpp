@@ -0,0 +1,169 @@
+#include "primitive_mesh.h"
+
+#include <array>
+#include <glm/gtc/constants.hpp>
+#include <vector>
+
+namespace vfs {
+
+namespace {
+// Point of a profile revolved around the y axis, with the normal in the (radial, y) plane
+struct ProfilePoint {
+    float radius;
+    float y;
+    glm::vec2 normal;
+};
+
+void AddQuad(gfx::CPUMesh& mesh, const std::array<gfx::Vertex, 4>& quad) {
+    const auto first = (u32)mesh.vertices.size();
+    mesh.vertices.insert(mesh.vertices.end(), quad.begin(), quad.end());
+
+    for (u32 i : {0u, 1u, 2u, 0u, 2u, 3u}) {
+        mesh.indices.push_back(first + i);
+    }
+}
+
+// Each strip is revolved separately, so the normals are not shared across sharp edges
+void AddRevolution(gfx::CPUMesh& mesh, const std::vector<ProfilePoint>& strip, u32 segments) {
+    const auto first = (u32)mesh.vertices.size();
+
+    for (u32 i = 0; i < strip.size(); i++) {
+        for (u32 j = 0; j <= segments; j++) {
+            const auto u = (float)j / (float)segments;
+            const auto angle = u * glm::two_pi<float>();
+            const auto c = glm::cos(angle);
+            const auto s = glm::sin(angle);
+            const auto& p = strip[i];
+
+            mesh.vertices.push_back({
+                .pos = {p.radius * c, p.y, p.radius * s},
+                .uv = {u, (float)i / (float)(strip.size() - 1)},
+                .normal = {p.normal.x * c, p.normal.y, p.normal.x * s},
+            });
+        }
+    }
+
+    const auto row = segments + 1;
+    for (u32 i = 0; i + 1 < strip.size(); i++) {
+        for (u32 j = 0; j < segments; j++) {
+            const auto a = first + i * row + j;
+            const auto b = a + row;
+
+            for (u32 idx : {a, b, a + 1, a + 1, b, b + 1}) {
+                mesh.indices.push_back(idx);
+            }
+        }
+    }
+}
+
+// Arc of radius `r` centered at height `y0`, from angle `from` to `to` measured from the y axis
+std::vector<ProfilePoint> Arc(float r, float y0, float from, float to, u32 steps) {
+    auto strip = std::vector<ProfilePoint>{};
+
+    for (u32 i = 0; i <= steps; i++) {
+        const auto angle = glm::mix(from, to, (float)i / (float)steps);
+        const auto n = glm::vec2(glm::sin(angle), glm::cos(angle));
+        strip.push_back({.radius = r * n.x, .y = y0 + r * n.y, .normal = n});
+    }
+
+    return strip;
+}
+
+void AddBox(gfx::CPUMesh& mesh, const glm::vec3& half) {
+    for (int axis = 0; axis < 3; axis++) {
+        for (float side : {-1.0f, 1.0f}) {
+            auto normal = glm::vec3(0.0f);
+            normal[axis] = side;
+
+            const auto u = glm::vec3(normal.y != 0.0f, normal.z != 0.0f, normal.x != 0.0f);
+            const auto v = glm::cross(normal, u);
+            const auto center = normal * half;
+            const auto du = u * half;
+            const auto dv = v * half;
+
+            AddQuad(mesh, {
+                              gfx::Vertex{.pos = center - du - dv, .uv = {0, 0}, .normal = normal},
+                              gfx::Vertex{.pos = center + du - dv, .uv = {1, 0}, .normal = normal},
+                              gfx::Vertex{.pos = center + du + dv, .uv = {1, 1}, .normal = normal},
+                              gfx::Vertex{.pos = center - du + dv, .uv = {0, 1}, .normal = normal},
+                          });
+        }
+    }
+}
+}  // namespace
+
+gfx::CPUMesh CreatePrimitiveMesh(BoundaryShape shape,
+                                 const glm::vec3& size,
+                                 float plane_extent,
+                                 u32 segments) {
+    auto mesh = gfx::CPUMesh{};
+    const auto pi = glm::pi<float>();
+    const auto r = size.x;
+    const auto h = size.y;
+
+    switch (shape) {
+    case BoundaryShape::Box:
+        mesh.name = "Box";
+        AddBox(mesh, size);
+        break;
+
+    case BoundaryShape::Sphere:
+        mesh.name = "Sphere";
+        AddRevolution(mesh, Arc(r, 0.0f, 0.0f, pi, segments / 2), segments);
+        break;
+
+    case BoundaryShape::Capsule:
+        mesh.name = "Capsule";
+        AddRevolution(mesh, Arc(r, h, 0.0f, 0.5f * pi, segments / 4), segments);
+        AddRevolution(mesh, {{r, h, {1, 0}}, {r, -h, {1, 0}}}, segments);
+        AddRevolution(mesh, Arc(r, -h, 0.5f * pi, pi, segments / 4), segments);
+        break;
+
+    case BoundaryShape::Cylinder:
+        mesh.name = "Cylinder";
+        AddRevolution(mesh, {{0, h, {0, 1}}, {r, h, {0, 1}}}, segments);
+        AddRevolution(mesh, {{r, h, {1, 0}}, {r, -h, {1, 0}}}, segments);
+        AddRevolution(mesh, {{r, -h, {0, -1}}, {0, -h, {0, -1}}}, segments);
+        break;
+
+    case BoundaryShape::Plane: {
+        mesh.name = "Plane";
+        const auto e = 0.5f * plane_extent;
+        const auto n = glm::vec3(0.0f, 1.0f, 0.0f);
+        AddQuad(mesh, {
+                          gfx::Vertex{.pos = {-e, 0, -e}, .uv = {0, 0}, .normal = n},
+                          gfx::Vertex{.pos = {e, 0, -e}, .uv = {1, 0}, .normal = n},
+                          gfx::Vertex{.pos = {e, 0, e}, .uv = {1, 1}, .normal = n},
+                          gfx::Vertex{.pos = {-e, 0, e}, .uv = {0, 1}, .normal = n},
+                      });
+        break;
+    }
+
+    case BoundaryShape::Mesh:
+        break;
+    }
+
+    return mesh;
+}
+
+float PrimitiveDistance(BoundaryShape shape, const glm::vec3& size, const glm::vec3& p) {
+    switch (shape) {
+    case BoundaryShape::Box: {
+        const auto q = glm::abs(p) - size;
+        return glm::length(glm::max(q, 0.0f)) + glm::min(glm::max(q.x, glm::max(q.y, q.z)), 0.0f);
+    }
+    case BoundaryShape::Sphere:
+        return glm::length(p) - size.x;
+    case BoundaryShape::Capsule:
+        return glm::length(p - glm::vec3(0.0f, glm::clamp(p.y, -size.y, size.y), 0.0f)) - size.x;
+    case BoundaryShape::Cylinder: {
+        const auto d = glm::abs(glm::vec2(glm::length(glm::vec2(p.x, p.z)), p.y)) -
+                       glm::vec2(size.x, size.y);
+        return glm::min(glm::max(d.x, d.y), 0.0f) + glm::length(glm::max(d, 0.0f));
+    }
+    default:
+        return p.y;
+    }
+}
+
+}  // namespace vfs
@@ -0,0 +1,19 @@
+#pragma once
+
+#include "gfx/mesh.h"
+#include "models/volume_map_boundary.h"
+
+namespace vfs {
+
+// Triangle mesh of a boundary primitive in its local frame, only used to draw it. Planes are drawn
+// as a square of side `plane_extent`.
+gfx::CPUMesh CreatePrimitiveMesh(BoundaryShape shape,
+                                 const glm::vec3& size,
+                                 float plane_extent,
+                                 u32 segments = 32);
+
+// Signed distance to a primitive in its local frame, negative inside. Same as PrimitiveDistance in
+// volume_map_boundary.slang.
+float PrimitiveDistance(BoundaryShape shape, const glm::vec3& size, const glm::vec3& p);
+
+}  // namespace vfs
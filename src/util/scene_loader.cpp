@@ -4,11 +4,16 @@
 #include <glm/fwd.hpp>
 #include <memory>
 #include <nlohmann/json.hpp>
+#include <stdexcept>
 
 #include "gfx/common.h"
 #include "gfx/mesh.h"
 #include "gfx/transform.h"
+#include "models/dfsph_model.h"
+#include "models/flip_model.h"
+#include "models/iisph_model.h"
 #include "models/model.h"
+#include "models/pbf_model.h"
 #include "models/wcsph_with_boundary_model.h"
 #include "scenes/generic_scene.h"
 #include "scenes/scene.h"
@@ -59,7 +64,142 @@ void from_json(const json& j, WCSPHWithBoundaryModel::Parameters& par) {
     j.at("stiffness").get_to(par.stiffness);
     j.at("expoent").get_to(par.expoent);
     j.at("viscosityStrenght").get_to(par.viscosity_strenght);
-    j.at("outerWallStiffness").get_to(par.wall_stiffness);
+}
+
+void from_json(const json& j, DFSPHModel::Parameters& par) {
+    j.at("viscosityStrenght").get_to(par.viscosity_strenght);
+}
+
+void from_json(const json& j, IISPHModel::Parameters& par) {
+    j.at("viscosityStrenght").get_to(par.viscosity_strenght);
+    if (j.contains("relaxation"))
+        j.at("relaxation").get_to(par.omega);
+}
+
+void from_json(const json& j, PBFModel::Parameters& par) {
+    if (j.contains("relaxation"))
+        j.at("relaxation").get_to(par.relaxation);
+    if (j.contains("artificialPressure"))
+        j.at("artificialPressure").get_to(par.artificial_pressure);
+    if (j.contains("artificialPressureRadius"))
+        j.at("artificialPressureRadius").get_to(par.artificial_pressure_radius);
+    if (j.contains("artificialPressureExponent"))
+        j.at("artificialPressureExponent").get_to(par.artificial_pressure_exponent);
+    if (j.contains("xsphViscosity"))
+        j.at("xsphViscosity").get_to(par.xsph_viscosity);
+    if (j.contains("constraintIterations"))
+        j.at("constraintIterations").get_to(par.constraint_iterations);
+}
+
+void from_json(const json& j, FLIPModel::Parameters& par) {
+    if (j.contains("cellSize"))
+        j.at("cellSize").get_to(par.cell_size);
+    if (j.contains("flipRatio"))
+        j.at("flipRatio").get_to(par.flip_ratio);
+    if (j.contains("apic"))
+        par.apic = j.at("apic").get<bool>() ? 1 : 0;
+}
+
+void from_json(const json& j, GPUSolverLoop::Config& config) {
+    if (j.contains("tolerance"))
+        j.at("tolerance").get_to(config.tolerance);
+    if (j.contains("minIterations"))
+        j.at("minIterations").get_to(config.min_iterations);
+    if (j.contains("maxIterations"))
+        j.at("maxIterations").get_to(config.max_iterations);
+}
+
+void from_json(const json& j, DFSPHModel::SolverConfig& config) {
+    if (j.contains("divergenceSolve"))
+        j.at("divergenceSolve").get_to(config.divergence_solve);
+    if (j.contains("densitySolver"))
+        j.at("densitySolver").get_to(config.density);
+    if (j.contains("divergenceSolver"))
+        j.at("divergenceSolver").get_to(config.divergence);
+}
+
+void from_json(const json& j, WCSPHWithBoundaryModel::ViscositySolver& viscosity) {
+    if (j.contains("implicitViscosity"))
+        j.at("implicitViscosity").get_to(viscosity.implicit);
+    if (j.contains("viscositySolver"))
+        j.at("viscositySolver").get_to(viscosity.solver);
+}
+
+void from_json(const json& j, SPHModel::AdaptiveTimeStep& config) {
+    if (j.contains("enabled"))
+        j.at("enabled").get_to(config.enabled);
+    if (j.contains("cfl"))
+        j.at("cfl").get_to(config.cfl);
+    if (j.contains("forceFactor"))
+        j.at("forceFactor").get_to(config.force_factor);
+    if (j.contains("maxGrowth"))
+        j.at("maxGrowth").get_to(config.max_growth);
+    if (j.contains("minDtScale"))
+        j.at("minDtScale").get_to(config.min_dt_scale);
+    if (j.contains("maxDtScale"))
+        j.at("maxDtScale").get_to(config.max_dt_scale);
+}
+
+void from_json(const json& j, GenericScene::ModelDef& model) {
+    const auto name = j.value("fluidModel", std::string("wcsph"));
+
+    if (j.contains("adaptiveTimeStep"))
+        j.at("adaptiveTimeStep").get_to(model.adaptive_time_step);
+
+    if (name == "dfsph") {
+        model.type = GenericScene::FluidModel::DFSPH;
+        j.at("dfsphParameters").get_to(model.dfsph);
+        j.at("dfsphParameters").get_to(model.dfsph_solver);
+        return;
+    }
+
+    if (name == "iisph") {
+        model.type = GenericScene::FluidModel::IISPH;
+        j.at("iisphParameters").get_to(model.iisph);
+        if (j.at("iisphParameters").contains("pressureSolver"))
+            j.at("iisphParameters").at("pressureSolver").get_to(model.iisph_solver);
+        return;
+    }
+
+    if (name == "pbf") {
+        model.type = GenericScene::FluidModel::PBF;
+        if (j.contains("pbfParameters"))
+            j.at("pbfParameters").get_to(model.pbf);
+        return;
+    }
+
+    if (name == "flip") {
+        model.type = GenericScene::FluidModel::FLIP;
+        if (j.contains("flipParameters")) {
+            j.at("flipParameters").get_to(model.flip);
+            if (j.at("flipParameters").contains("pressureSolver"))
+                j.at("flipParameters").at("pressureSolver").get_to(model.flip_solver);
+        }
+        return;
+    }
+
+    if (name != "wcsph")
+        fmt::println("Unknown fluid model {}, using wcsph", name);
+
+    model.type = GenericScene::FluidModel::WCSPH;
+    j.at("wcsphParameters").get_to(model.wcsph);
+    j.at("wcsphParameters").get_to(model.wcsph_viscosity);
+    model.wcsph_fused_kernels = j.at("wcsphParameters").value("fusedKernels", false);
+}
+
+void from_json(const json& j, SpatialHash::Config& config) {
+    if (j.contains("tableSize"))
+        j.at("tableSize").get_to(config.table_size);
+    if (j.contains("loadFactor"))
+        j.at("loadFactor").get_to(config.load_factor);
+    if (j.contains("verletSkin"))
+        j.at("verletSkin").get_to(config.verlet_skin);
+    if (j.contains("incrementalSortThreshold"))
+        j.at("incrementalSortThreshold").get_to(config.incremental_sort_threshold);
+    if (j.contains("maxNeighbors"))
+        j.at("maxNeighbors").get_to(config.max_neighbors);
+    if (j.contains("cellTiles"))
+        j.at("cellTiles").get_to(config.cell_tiles);
 }
 
 void from_json(const json& j, std::vector<GenericScene::FluidBlock>& blocks) {
@@ -72,6 +212,39 @@ void from_json(const json& j, std::vector<GenericScene::FluidBlock>& blocks) {
     }
 }
 
+// Primitives are sized in world units: "size" is the full size of a box, "radius" and "height"
+// (of the straight part, along local y) are used by the round shapes. Heightfields read a PNG or
+// RAW "heightmap" that spans "size", the RAW ones with an optional "heightmapResolution".
+void ParsePrimitive(const json& j, GenericScene::ObjectDef& obj) {
+    const auto shape = j.at("shape").get<std::string>();
+
+    if (shape == "box") {
+        obj.shape = BoundaryShape::Box;
+        j.at("size").get_to(obj.size);
+        obj.size *= 0.5f;
+    } else if (shape == "sphere") {
+        obj.shape = BoundaryShape::Sphere;
+        obj.size.x = j.at("radius").get<float>();
+    } else if (shape == "capsule" || shape == "cylinder") {
+        obj.shape = shape == "capsule" ? BoundaryShape::Capsule : BoundaryShape::Cylinder;
+        obj.size.x = j.at("radius").get<float>();
+        obj.size.y = 0.5f * j.at("height").get<float>();
+    } else if (shape == "plane") {
+        obj.shape = BoundaryShape::Plane;
+    } else if (shape == "heightfield") {
+        obj.shape = BoundaryShape::Heightfield;
+        j.at("heightmap").get_to(obj.path);
+        j.at("size").get_to(obj.size);
+        if (j.contains("heightmapResolution")) {
+            const auto res = j.at("heightmapResolution").get<std::vector<u32>>();
+            obj.resolution = glm::uvec3(res.at(0), res.at(1), 0);
+        }
+    } else {
+        // Same as a missing required key, any fallback shape would silently change the scene
+        throw std::invalid_argument(fmt::format("Unknown boundary shape \"{}\"", shape));
+    }
+}
+
 void from_json(const json& j, std::vector<GenericScene::ObjectDef>& objects) {
     objects.resize(j.size());
     u32 i = 0;
@@ -80,7 +253,10 @@ void from_json(const json& j, std::vector<GenericScene::ObjectDef>& objects) {
 
         auto& o = it.value();
 
-        o.at("resourcePath").get_to(obj.path);
+        if (o.contains("shape"))
+            ParsePrimitive(o, obj);
+        else
+            o.at("resourcePath").get_to(obj.path);
 
         obj.transform = gfx::Transform{};
 
@@ -104,7 +280,8 @@ void from_json(const json& j, std::vector<GenericScene::ObjectDef>& objects) {
             obj.transform.SetScale(scale);
         }
 
-        o.at("volumeMapResolution").get_to(obj.resolution);
+        if (obj.shape == BoundaryShape::Mesh)
+            o.at("volumeMapResolution").get_to(obj.resolution);
 
         objects[i++] = obj;
     }
@@ -124,8 +301,12 @@ std::unique_ptr<SceneBase> LoadScene(gfx::Device& gfx, const std::string& config
     SPHModel::Parameters base_parameter{};
     data["simulationParameters"].get_to(base_parameter);
 
-    WCSPHWithBoundaryModel::Parameters model_parameter{};
-    data["wcsphParameters"].get_to(model_parameter);
+    GenericScene::ModelDef model{};
+    data.get_to(model);
+
+    SpatialHash::Config spatial_hash_config{};
+    if (data.contains("spatialHash"))
+        data["spatialHash"].get_to(spatial_hash_config);
 
     auto fluid_blocks = std::vector<GenericScene::FluidBlock>{};
     data["fluidBlocks"].get_to(fluid_blocks);
@@ -133,8 +314,9 @@ std::unique_ptr<SceneBase> LoadScene(gfx::Device& gfx, const std::string& config
     auto boundary_objects = std::vector<GenericScene::ObjectDef>{};
     data["boundaryObjects"].get_to(boundary_objects);
 
-    auto scene = std::make_unique<GenericScene>(gfx, base_parameter, model_parameter, fluid_blocks,
-                                                boundary_objects);
+    auto scene = std::make_unique<GenericScene>(gfx, base_parameter, model, spatial_hash_config,
+                                                fluid_blocks, boundary_objects);
+    scene->SetFilterBoundaryGrids(data.value("filterBoundaryGrids", true));
 
     return scene;
 }
@@ -5,15 +5,45 @@
 #include "util/gaussian_quadrature.h"
 #include "util/geometry.h"
 #include "util/kernel.h"
+#include "util/primitive_mesh.h"
+
+namespace {
+// Volume of the solid within the support around `x`, weighted by the kernel outside of it
+template <typename DistanceFunc>
+double VolumeAt(const glm::vec3& x, float support_radius, const DistanceFunc& calc_distance) {
+    const auto integration_domain = vfs::AABB{.pos_min = glm::vec3(-support_radius),
+                                              .pos_max = glm::vec3(support_radius)};
+    auto kernel = vfs::CubicSplineKernel(support_radius);
+
+    auto integrand = [&](const glm::vec3& xi) -> double {
+        if (glm::length2(xi) > support_radius * support_radius) {
+            return 0.0;
+        }
+
+        auto dist_i = calc_distance(x + xi);
+
+        if (dist_i <= 0.0) {
+            return 1.0;
+        }
+
+        else if (dist_i < support_radius) {
+            return kernel.W(dist_i) / kernel.WZero();
+        }
+
+        else {
+            return 0;
+        }
+    };
+
+    return 0.8 * vfs::GaussLegendreQuadrature3D(integration_domain, 16, integrand);
+}
+}  // namespace
 
 void vfs::GenerateVolumeMap(const MeshSDF& sdf,
                             float support_radius,
                             LinearLagrangeDiscreteGrid& volume_map) {
     const auto box = sdf.GetBox();
     const auto domain = AABB{.pos_min = box.pos, .pos_max = box.pos + box.size};
-    const auto integration_domain =
-        AABB{.pos_min = glm::vec3(-support_radius), .pos_max = glm::vec3(support_radius)};
-    auto kernel = CubicSplineKernel(support_radius);
 
     auto calc_sdf_distance = [&sdf](const glm::vec3& x) -> double {
         // TODO: compare to sdf.Interpolate(x);
@@ -27,28 +57,26 @@ void vfs::GenerateVolumeMap(const MeshSDF& sdf,
             return 0.0;
         }
 
-        auto integrand = [&](const glm::vec3& xi) -> double {
-            if (glm::length2(xi) > support_radius * support_radius) {
-                return 0.0;
-            }
-
-            auto dist_i = calc_sdf_distance(x + xi);
-
-            if (dist_i <= 0.0) {
-                return 1.0;
-            }
-
-            else if (dist_i < support_radius) {
-                return kernel.W(dist_i) / kernel.WZero();
-            }
+        return VolumeAt(x, support_radius, calc_sdf_distance);
+    };
 
-            else {
-                return 0;
-            }
-        };
+    volume_map.Init(sdf.GetResolution(), domain, volume_map_func);
+}
 
-        return 0.8 * GaussLegendreQuadrature3D(integration_domain, 16, integrand);
+std::vector<float> vfs::GeneratePrimitiveVolumeTable(BoundaryShape shape,
+                                                     const glm::vec3& size,
+                                                     float support_radius,
+                                                     u32 n) {
+    auto calc_distance = [&](const glm::vec3& x) -> double {
+        return PrimitiveDistance(shape, size, x);
     };
 
-    volume_map.Init(sdf.GetResolution(), domain, volume_map_func);
+    auto table = std::vector<float>(n);
+    for (u32 i = 0; i < n; i++) {
+        const auto dist = support_radius * (float)i / (float)(n - 1);
+        const auto x = glm::vec3(size.x + dist, 0.0f, 0.0f);
+        table[i] = (float)VolumeAt(x, support_radius, calc_distance);
+    }
+
+    return table;
 }
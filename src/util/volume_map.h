@@ -1,5 +1,8 @@
 #pragma once
 
+#include <vector>
+
+#include "models/volume_map_boundary.h"
 #include "util/discretization.h"
 #include "util/mesh_sdf.h"
 namespace vfs {
@@ -8,4 +11,13 @@ void GenerateVolumeMap(const MeshSDF& sdf,
                        float support_radius,
                        LinearLagrangeDiscreteGrid& volume_map);
 
+// Volume map of a round primitive (sphere, capsule or cylinder) on the side of its local x axis, at
+// `n` distances from the surface evenly spaced over [0, support_radius]. A curved surface has less
+// volume within the support than the flat wall at the same distance, more so for radii close to the
+// support radius.
+std::vector<float> GeneratePrimitiveVolumeTable(BoundaryShape shape,
+                                                const glm::vec3& size,
+                                                float support_radius,
+                                                u32 n);
+
 }  // namespace vfs